@@ -1,5 +1,7 @@
 #include "Execution.h"
 
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 
@@ -7,6 +9,7 @@
 #include <thread>
 #endif
 
+#include "BlendingSimulator/BlendingMetrics.h"
 #include "BlendingSimulator/BlendingSimulator.h"
 
 #ifdef FAST_SIMULATOR_AVAILABLE
@@ -22,6 +25,7 @@
 #endif
 
 #include "BlendingSimulator/ParticleParameters.h"
+#include "Npy.h"
 
 #ifdef VISUALIZER_AVAILABLE
 
@@ -31,6 +35,224 @@
 
 namespace bs = blendingsimulator;
 
+std::streambuf* openOutput(const std::string& filename, std::ofstream& of)
+{
+	if (filename == "stdout") {
+		return std::cout.rdbuf();
+	}
+
+	of.open(filename);
+	return of.rdbuf();
+}
+
+void writeMetrics(
+	const std::vector<bs::BlendingMetrics<bs::AveragedParameters>>& metrics,
+	const std::vector<float>& angles,
+	const std::string& filename
+)
+{
+	std::cerr << "Writing metrics into '" << filename << "'" << std::endl;
+
+	std::ofstream of;
+	std::ostream out(openOutput(filename, of));
+
+	if (out) {
+		// Angle column only distinguishes rows when several reclaim angles were evaluated
+		const bool writeAngle = metrics.size() > 1;
+		if (writeAngle) {
+			out << "angle\t";
+		}
+		out << "parameter\tinput_mean\tinput_stddev\toutput_mean\toutput_stddev\tvariance_reduction_ratio\thomogenization_efficiency\n";
+		for (size_t a = 0; a < metrics.size(); a++) {
+			for (unsigned int i = 0; i < metrics[a].getValueCount(); i++) {
+				const bs::WeightedStatistics& input = metrics[a].getInputStatistics(i);
+				const bs::WeightedStatistics& output = metrics[a].getOutputStatistics(i);
+				if (writeAngle) {
+					out << angles[a] << "\t";
+				}
+				out << "p_" << (i + 1)
+					<< "\t" << input.getMean() << "\t" << input.getStandardDeviation()
+					<< "\t" << output.getMean() << "\t" << output.getStandardDeviation()
+					<< "\t" << metrics[a].getVarianceReductionRatio(i) << "\t" << metrics[a].getHomogenizationEfficiency(i) << "\n";
+			}
+		}
+		out.flush();
+		std::cerr << "Metrics written" << std::endl;
+	} else {
+		std::cerr << "Could not open output file stream for filename '" << filename << "'" << std::endl;
+	}
+}
+
+namespace
+{
+// Writes reclaim rows of all reclaim angles and collects their output statistics, rows may be written while stacking
+class ReclaimOutput
+{
+	public:
+		ReclaimOutput(
+			bs::BlendingSimulator<bs::AveragedParameters>& simulator,
+			const ExecutionParameters& parameters,
+			std::vector<bs::BlendingMetrics<bs::AveragedParameters>>& metrics
+		)
+			: simulator(simulator)
+			, parameters(parameters)
+			, metrics(metrics)
+			, out(nullptr)
+			, positions(simulator.getReclaimAngleCount(), 0.0f)
+		{
+			if (!parameters.reclaimFile.empty()) {
+				std::cerr << "Reclaiming into '" << parameters.reclaimFile << "'" << std::endl;
+				out.rdbuf(openOutput(parameters.reclaimFile, of));
+				if (parameters.reclaimFile != "stdout" && !of.is_open()) {
+					std::cerr << "Could not open output file stream for filename '" << parameters.reclaimFile << "'" << std::endl;
+					out.rdbuf(nullptr);
+				}
+			} else {
+				std::cerr << "Reclaiming for metrics" << std::endl;
+			}
+		}
+
+		// Reclaims angle a up to limit, the parameter count has to be known before the first row
+		void reclaimUntil(unsigned int a, float limit, int parameterCount)
+		{
+			while (positions[a] <= limit && !simulator.reclaimingFinished(a)) {
+				reclaimRow(a, parameterCount);
+			}
+		}
+
+		void reclaimAll(int parameterCount)
+		{
+			for (unsigned int a = 0; a < positions.size(); a++) {
+				while (!simulator.reclaimingFinished(a)) {
+					reclaimRow(a, parameterCount);
+				}
+			}
+
+			if (out) {
+				out.flush();
+			}
+			if (of.is_open()) {
+				of.close();
+			}
+		}
+
+	private:
+		bs::BlendingSimulator<bs::AveragedParameters>& simulator;
+		const ExecutionParameters& parameters;
+		std::vector<bs::BlendingMetrics<bs::AveragedParameters>>& metrics;
+
+		std::ofstream of;
+		std::ostream out;
+		bool headerWritten = false;
+		std::vector<float> positions;
+		bs::AveragedParameters p;
+
+		void reclaimRow(unsigned int a, int parameterCount)
+		{
+			simulator.reclaimInto(a, positions[a], p);
+
+			if (!metrics.empty()) {
+				metrics[a].pushOutput(p);
+			}
+
+			if (out) {
+				// Angle column only distinguishes rows when several reclaim angles are evaluated
+				const bool writeAngle = positions.size() > 1;
+				if (!headerWritten) {
+					if (writeAngle) {
+						out << "angle\t";
+					}
+					out << "position\tvolume";
+					for (int i = 0; i < parameterCount; i++) {
+						out << "\tp_" << (i + 1);
+					}
+					out << "\n";
+					headerWritten = true;
+				}
+
+				if (writeAngle) {
+					out << simulator.getReclaimAngle(a) << "\t";
+				}
+				out << positions[a] << "\t" << p.getVolume();
+				for (int i = 0; i < parameterCount; i++) {
+					out << "\t" << p.getValue(i);
+				}
+				out << "\n";
+				if (parameters.streamReclaim) {
+					out.flush();
+				}
+			}
+
+			positions[a] += parameters.reclaimIncrement;
+		}
+};
+}
+
+void parseInputLine(const std::string& line, int& parameterCount, InputRecord& record)
+{
+	BLENDINGSIMULATOR_TRACE_SCOPE("parseInput");
+
+	std::stringstream lineStream(line);
+
+	if (!(lineStream >> record.time)) {
+		throw std::runtime_error("invalid time");
+	}
+
+	if (!(lineStream >> record.x)) {
+		throw std::runtime_error("invalid x position");
+	}
+
+	if (!(lineStream >> record.z)) {
+		throw std::runtime_error("invalid z position");
+	}
+
+	if (!(lineStream >> record.volume)) {
+		throw std::runtime_error("invalid volume");
+	}
+
+	std::vector<double>& values = record.values;
+
+	if (parameterCount >= 0) {
+		values.resize(static_cast<unsigned long>(parameterCount));
+		for (unsigned int i = 0; i < parameterCount; i++) {
+			if (!(lineStream >> values[i])) {
+				throw std::runtime_error("invalid value at position " + std::to_string(i));
+			}
+		}
+
+		std::string trash;
+		if (lineStream >> trash) {
+			throw std::runtime_error("non-empty line after parsing all parameters");
+		}
+	} else {
+		// Determine parameter count
+		values.clear();
+		double value;
+		while (lineStream >> value) {
+			// Slow but executed only for first row and parameter count is usually very low
+			values.push_back(value);
+		}
+		parameterCount = static_cast<int>(values.size());
+	}
+}
+
+std::unique_ptr<bs::BlendingSimulator<bs::AveragedParameters>> createSimulator(bool detailed, const bs::SimulationParameters& simulationParameters)
+{
+	if (detailed) {
+#ifdef DETAILED_SIMULATOR_AVAILABLE
+		return std::unique_ptr<bs::BlendingSimulator<bs::AveragedParameters>>(new bs::BlendingSimulatorDetailed<bs::AveragedParameters>(simulationParameters));
+#else
+		throw std::runtime_error("Detailed simulation not available");
+#endif
+	} else {
+#ifdef FAST_SIMULATOR_AVAILABLE
+		return std::unique_ptr<bs::BlendingSimulator<bs::AveragedParameters>>(new bs::BlendingSimulatorFast<bs::AveragedParameters>(simulationParameters));
+#else
+		throw std::runtime_error("Fast simulation not available");
+#endif
+	}
+}
+
 void executeSimulation(bs::BlendingSimulator<bs::AveragedParameters>& simulator, const ExecutionParameters& parameters)
 {
 	std::cerr << "Initializing simulation" << std::endl;
@@ -58,57 +280,61 @@ void executeSimulation(bs::BlendingSimulator<bs::AveragedParameters>& simulator,
 
 	std::cerr << "Starting stacking from stdin" << std::endl;
 
+	// Input statistics are shared by all reclaim angles
+	const unsigned int angleCount = simulator.getReclaimAngleCount();
+	const bool collectMetrics = !parameters.metricsFile.empty();
+	std::vector<bs::BlendingMetrics<bs::AveragedParameters>> metrics(collectMetrics ? angleCount : 0);
+
+	const bool reclaim = !parameters.reclaimFile.empty() || collectMetrics;
+	std::unique_ptr<ReclaimOutput> reclaimOutput;
+	if (reclaim) {
+		reclaimOutput.reset(new ReclaimOutput(simulator, parameters, metrics));
+	}
+
 	std::string line;
 	int parameterCount = -1;
+	InputRecord record;
+	InputPath path;
+	float stackerMaxX = 0.0f;
+	bool stackerReturned = false;
 	while (std::getline(std::cin, line) && !cancel.load()) {
-		std::stringstream lineStream(line);
+		// Further input is pointless as finishing reports the failure of the stacking worker
+		if (simulator.hasStackingFailed()) {
+			break;
+		}
 
 		try {
-			double time;
-			if (!(lineStream >> time)) {
-				throw std::runtime_error("invalid time");
-			}
+			parseInputLine(line, parameterCount, record);
 
-			float xPos;
-			if (!(lineStream >> xPos)) {
-				throw std::runtime_error("invalid x position");
+			float x0 = record.x;
+			float z0 = record.z;
+			if (parameters.pathInput) {
+				path.advance(record, x0, z0);
 			}
 
-			float zPos;
-			if (!(lineStream >> zPos)) {
-				throw std::runtime_error("invalid z position");
+			bs::AveragedParameters p(record.volume, record.values);
+			for (auto& m : metrics) {
+				m.pushInput(p);
 			}
 
-			double volume;
-			if (!(lineStream >> volume)) {
-				throw std::runtime_error("invalid volume");
-			}
+			if (parameters.streamReclaim) {
+				// Stacking synchronously keeps the heights consistent with the finalized positions
+				simulator.stackAlong(x0, z0, record.x, record.z, p);
 
-			std::vector<double> values;
-
-			if (parameterCount >= 0) {
-				values.resize(static_cast<unsigned long>(parameterCount));
-				for (unsigned int i = 0; i < parameterCount; i++) {
-					if (!(lineStream >> values[i])) {
-						throw std::runtime_error("invalid value at position " + std::to_string(i));
-					}
+				if (record.x < stackerMaxX && !stackerReturned) {
+					std::cerr << "Stacker moved backwards, streamed reclaim rows may miss material" << std::endl;
+					stackerReturned = true;
 				}
+				stackerMaxX = std::max(stackerMaxX, record.x);
 
-				std::string trash;
-				if (lineStream >> trash) {
-					throw std::runtime_error("non-empty line after parsing all parameters");
+				if (reclaimOutput) {
+					for (unsigned int a = 0; a < angleCount; a++) {
+						reclaimOutput->reclaimUntil(a, simulator.finalizedReclaimPosition(a, record.x), parameterCount);
+					}
 				}
 			} else {
-				// Determine parameter count
-				double value;
-				while (lineStream >> value) {
-					// Slow but executed only for first row and parameter count is usually very low
-					values.push_back(value);
-				}
-				parameterCount = static_cast<int>(values.size());
+				simulator.stackAlongAsync(x0, z0, record.x, record.z, p);
 			}
-
-			simulator.stack(xPos, zPos, bs::AveragedParameters(volume, values));
 		} catch (std::exception& e) {
 			std::cerr << "could not match line '" << line << "': " << e.what() << std::endl;
 		}
@@ -117,7 +343,10 @@ void executeSimulation(bs::BlendingSimulator<bs::AveragedParameters>& simulator,
 	std::cerr << "Stacking input stopped" << std::endl;
 
 	cancel.store(true);
-	simulator.finishStacking();
+	{
+		BLENDINGSIMULATOR_TRACE_SCOPE("finishStacking");
+		simulator.finishStackingAsync().get();
+	}
 
 	std::cerr << "Stacking finished" << std::endl;
 
@@ -130,86 +359,88 @@ void executeSimulation(bs::BlendingSimulator<bs::AveragedParameters>& simulator,
 #endif
 
 	if (!parameters.heightsFile.empty()) {
+		BLENDINGSIMULATOR_TRACE_SCOPE("writeHeights");
 		std::cerr << "Writing height map into '" << parameters.heightsFile << "'" << std::endl;
-		std::ofstream out(parameters.heightsFile);
-
-		if (out) {
-			auto heapMapSize = simulator.getHeapMapSize();
-			const float* heapMap = simulator.getHeapMap(); // +1 for Y coordinate
-			for (int z = 0; z < heapMapSize.second; z++) {
-				for (int x = 0; x < heapMapSize.first; x++) {
-					if (x > 0) {
-						out << "\t";
+		const auto heapMapSize = simulator.getHeapMapSize();
+		const float* heapMap = simulator.getHeapMap();
+
+		const std::string npyExtension = ".npy";
+		const std::string& filename = parameters.heightsFile;
+		if (filename.size() >= npyExtension.size() && filename.compare(filename.size() - npyExtension.size(), npyExtension.size(), npyExtension) == 0) {
+			// Can be loaded again by --initialheights
+			writeNpyMatrix(filename, heapMap, heapMapSize.second, heapMapSize.first);
+			std::cerr << "Height map written" << std::endl;
+		} else {
+			std::ofstream out(filename);
+			if (out) {
+				for (unsigned int z = 0; z < heapMapSize.second; z++) {
+					for (unsigned int x = 0; x < heapMapSize.first; x++) {
+						if (x > 0) {
+							out << "\t";
+						}
+						out << heapMap[z * heapMapSize.first + x];
 					}
-					out << heapMap[z * heapMapSize.first + x + 1];
+					out << "\n";
 				}
-				out << "\n";
+				out.close();
+				std::cerr << "Height map written" << std::endl;
+			} else {
+				std::cerr << "Could not open output file stream for filename '" << filename << "'" << std::endl;
 			}
-			out.close();
-			std::cerr << "Height map written" << std::endl;
-		} else {
-			std::cerr << "Could not open output file stream for filename '" << parameters.heightsFile << "'" << std::endl;
 		}
 	}
 
-	if (!parameters.reclaimFile.empty()) {
-		std::cerr << "Reclaiming into '" << parameters.reclaimFile << "'" << std::endl;
+	if (reclaimOutput) {
+		BLENDINGSIMULATOR_TRACE_SCOPE("reclaimAll");
+		reclaimOutput->reclaimAll(parameterCount);
+		std::cerr << "Reclaiming finished" << std::endl;
+	}
 
-		std::streambuf* buf;
-		std::ofstream of;
-		if (parameters.reclaimFile == "stdout") {
-			buf = std::cout.rdbuf();
-		} else {
-			of.open(parameters.reclaimFile);
-			buf = of.rdbuf();
+	if (collectMetrics) {
+		BLENDINGSIMULATOR_TRACE_SCOPE("writeMetrics");
+		std::vector<float> angles;
+		for (unsigned int a = 0; a < angleCount; a++) {
+			angles.push_back(simulator.getReclaimAngle(a));
 		}
-		std::ostream out(buf);
-
-		if (out) {
-			out << "position\tvolume";
-			for (unsigned int i = 0; i < parameterCount; i++) {
-				out << "\tp_" << (i + 1);
-			}
-			out << "\n";
-
-			float position = 0.0f;
-			while (!simulator.reclaimingFinished()) {
-				bs::AveragedParameters p = simulator.reclaim(position);
+		writeMetrics(metrics, angles, parameters.metricsFile);
+	}
+}
 
-				out << position << "\t" << p.getVolume();
-				for (unsigned int i = 0; i < parameterCount; i++) {
-					out << "\t" << p.getValue(i);
-				}
-				out << "\n";
+void loadInitialHeights(bs::BlendingSimulator<bs::AveragedParameters>& simulator, const ExecutionParameters& parameters)
+{
+	std::cerr << "Loading initial heights from '" << parameters.initialHeightsFile << "'" << std::endl;
+
+	unsigned int rows;
+	unsigned int columns;
+	const std::vector<float> heights = readNpyMatrix(parameters.initialHeightsFile, rows, columns);
+
+	// Same layout as the written height map, one row per z cell
+	const auto heapMapSize = simulator.getHeapMapSize();
+	if (rows != heapMapSize.second || columns != heapMapSize.first) {
+		throw std::runtime_error(
+			"initial heights of shape (" + std::to_string(rows) + ", " + std::to_string(columns) + ") do not match the heap map of shape ("
+			+ std::to_string(heapMapSize.second) + ", " + std::to_string(heapMapSize.first) + ")"
+		);
+	}
 
-				position += parameters.reclaimIncrement;
-			}
-			out.flush();
-			if (of) {
-				of.close();
-			}
-			std::cerr << "Reclaiming finished" << std::endl;
-		} else {
-			std::cerr << "Could not open output file stream for filename '" << parameters.reclaimFile << "'" << std::endl;
-		}
+	if (parameters.initialComposition.empty()) {
+		simulator.loadInitialHeightmap(heights.data());
+	} else {
+		const bs::AveragedParameters composition(1.0, parameters.initialComposition);
+		simulator.loadInitialHeightmap(heights.data(), &composition);
 	}
 }
 
 void executeSimulation(const ExecutionParameters& executionParameters, const bs::SimulationParameters& simulationParameters)
 {
-	if (executionParameters.detailed) {
-#ifdef DETAILED_SIMULATOR_AVAILABLE
-		bs::BlendingSimulatorDetailed<bs::AveragedParameters> simulator(simulationParameters);
-		executeSimulation(simulator, executionParameters);
-#else
-		throw std::runtime_error("Detailed simulation not available");
-#endif
-	} else {
-#ifdef FAST_SIMULATOR_AVAILABLE
-		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
-		executeSimulation(simulator, executionParameters);
-#else
-		throw std::runtime_error("Fast simulation not available");
-#endif
+	const auto simulator = createSimulator(executionParameters.detailed, simulationParameters);
+	if (!executionParameters.initialHeightsFile.empty()) {
+		loadInitialHeights(*simulator, executionParameters);
+	}
+	executeSimulation(*simulator, executionParameters);
+
+	if (!executionParameters.traceFile.empty()) {
+		std::cerr << "Writing trace into '" << executionParameters.traceFile << "'" << std::endl;
+		bs::tracing::writeChromeTrace(executionParameters.traceFile);
 	}
 }
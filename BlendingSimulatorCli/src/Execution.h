@@ -1,9 +1,56 @@
 #ifndef BLENDINGSIMULATOR_EXECUTION_H
 #define BLENDINGSIMULATOR_EXECUTION_H
 
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "ExecutionParameters.h"
+#include "BlendingSimulator/BlendingSimulator.h"
+#include "BlendingSimulator/ParticleParameters.h"
 #include "BlendingSimulator/SimulationParameters.h"
 
+struct InputRecord
+{
+	double time;
+	float x;
+	float z;
+	double volume;
+	std::vector<double> values;
+};
+
+// Parses one input row into record, parameterCount is determined by the first row when negative
+void parseInputLine(const std::string& line, int& parameterCount, InputRecord& record);
+
+// Consecutive rows of path input describe the stacker path, the material of a row is spread from the previous position
+class InputPath
+{
+	public:
+		// Start (x0, z0) of the segment ending at the position of record, the first row is a single point
+		void advance(const InputRecord& record, float& x0, float& z0)
+		{
+			x0 = started ? x : record.x;
+			z0 = started ? z : record.z;
+			x = record.x;
+			z = record.z;
+			started = true;
+		}
+
+	private:
+		bool started = false;
+		float x = 0.0f;
+		float z = 0.0f;
+};
+
+// Output buffer of std::cout for "stdout", of the opened file otherwise
+std::streambuf* openOutput(const std::string& filename, std::ofstream& of);
+
+std::unique_ptr<blendingsimulator::BlendingSimulator<blendingsimulator::AveragedParameters>> createSimulator(
+	bool detailed,
+	const blendingsimulator::SimulationParameters& simulationParameters
+);
+
 void executeSimulation(const ExecutionParameters& parameters, const blendingsimulator::SimulationParameters& simulationParameters);
 
 #endif
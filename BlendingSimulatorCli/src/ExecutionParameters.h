@@ -2,6 +2,7 @@
 #define BLENDINGSIMULATOR_EXECUTIONPARAMETERS_H
 
 #include <string>
+#include <vector>
 
 struct ExecutionParameters
 {
@@ -11,6 +12,11 @@ struct ExecutionParameters
 	// Simulation Options
 	bool detailed = false;
 
+	// Parallel Execution Options
+	bool serve = false;
+	std::vector<std::string> sweeps;
+	unsigned int workers = 0;
+
 #ifdef VISUALIZER_AVAILABLE
 	// Visualization
 	bool visualize = false;
@@ -18,9 +24,15 @@ struct ExecutionParameters
 #endif
 
 	// Input / Output Options
+	bool pathInput = false;
+	std::string initialHeightsFile;
+	std::vector<double> initialComposition;
 	std::string heightsFile;
 	std::string reclaimFile;
+	std::string metricsFile;
 	float reclaimIncrement = 1.0f;
+	bool streamReclaim = false;
+	std::string traceFile;
 };
 
 #endif
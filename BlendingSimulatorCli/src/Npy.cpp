@@ -0,0 +1,151 @@
+#include "Npy.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+// Value of key in the header dictionary up to the next separator, e.g. 'descr': '<f4', 'shape': (3, 4)
+std::string getHeaderValue(const std::string& header, const std::string& key)
+{
+	const size_t keyPosition = header.find("'" + key + "'");
+	if (keyPosition == std::string::npos) {
+		throw std::runtime_error("npy header lacks '" + key + "'");
+	}
+
+	size_t begin = header.find(':', keyPosition);
+	if (begin == std::string::npos) {
+		throw std::runtime_error("invalid npy header");
+	}
+	begin = header.find_first_not_of(' ', begin + 1);
+
+	size_t end;
+	if (header[begin] == '(') {
+		end = header.find(')', begin) + 1;
+	} else if (header[begin] == '\'') {
+		end = header.find('\'', begin + 1) + 1;
+	} else {
+		end = header.find_first_of(",}", begin);
+	}
+	if (begin == std::string::npos || end == std::string::npos || end == 0) {
+		throw std::runtime_error("invalid npy header");
+	}
+	return header.substr(begin, end - begin);
+}
+
+template<typename T>
+void readValues(std::istream& in, std::vector<float>& values)
+{
+	std::vector<char> bytes(values.size() * sizeof(T));
+	if (!in.read(bytes.data(), std::streamsize(bytes.size()))) {
+		throw std::runtime_error("truncated npy data");
+	}
+	for (size_t i = 0; i < values.size(); i++) {
+		T value;
+		std::memcpy(&value, bytes.data() + i * sizeof(T), sizeof(T));
+		values[i] = float(value);
+	}
+}
+}
+
+std::vector<float> readNpyMatrix(const std::string& filename, unsigned int& rows, unsigned int& columns)
+{
+	std::ifstream in(filename, std::ios::binary);
+	if (!in) {
+		throw std::runtime_error("could not open '" + filename + "'");
+	}
+
+	char magic[8];
+	if (!in.read(magic, 8) || std::memcmp(magic, "\x93NUMPY", 6) != 0) {
+		throw std::runtime_error("'" + filename + "' is not a npy file");
+	}
+
+	// Header length is 16 bit little endian in version 1 and 32 bit in later versions
+	const int major = static_cast<unsigned char>(magic[6]);
+	unsigned char lengthBytes[4] = {0, 0, 0, 0};
+	if (!in.read(reinterpret_cast<char*>(lengthBytes), major == 1 ? 2 : 4)) {
+		throw std::runtime_error("truncated npy header");
+	}
+	const uint32_t headerLength = lengthBytes[0] | (lengthBytes[1] << 8) | (lengthBytes[2] << 16) | (uint32_t(lengthBytes[3]) << 24);
+	std::string header(headerLength, '\0');
+	if (!in.read(&header[0], headerLength)) {
+		throw std::runtime_error("truncated npy header");
+	}
+
+	const std::string descr = getHeaderValue(header, "descr");
+	if (descr != "'<f4'" && descr != "'<f8'") {
+		throw std::runtime_error("unsupported npy type " + descr + ", expected float32 or float64");
+	}
+	const bool fortranOrder = getHeaderValue(header, "fortran_order") == "True";
+
+	std::string shape = getHeaderValue(header, "shape");
+	for (char& c : shape) {
+		if (c == '(' || c == ')' || c == ',') {
+			c = ' ';
+		}
+	}
+	std::istringstream shapeStream(shape);
+	std::vector<unsigned int> dimensions;
+	unsigned int dimension;
+	while (shapeStream >> dimension) {
+		dimensions.push_back(dimension);
+	}
+	if (dimensions.size() != 2) {
+		throw std::runtime_error("npy array has to be two dimensional");
+	}
+	rows = dimensions[0];
+	columns = dimensions[1];
+
+	std::vector<float> values(size_t(rows) * columns);
+	if (descr == "'<f4'") {
+		readValues<float>(in, values);
+	} else {
+		readValues<double>(in, values);
+	}
+
+	if (fortranOrder) {
+		std::vector<float> rowMajor(values.size());
+		for (size_t r = 0; r < rows; r++) {
+			for (size_t c = 0; c < columns; c++) {
+				rowMajor[r * columns + c] = values[c * rows + r];
+			}
+		}
+		values.swap(rowMajor);
+	}
+
+	return values;
+}
+
+void writeNpyMatrix(const std::string& filename, const float* values, unsigned int rows, unsigned int columns)
+{
+	std::ofstream out(filename, std::ios::binary);
+	if (!out) {
+		throw std::runtime_error("could not open '" + filename + "'");
+	}
+
+	// Version 1 header padded with spaces and terminated by a newline so that the data is 64 byte aligned
+	std::string header = "{'descr': '<f4', 'fortran_order': False, 'shape': (" + std::to_string(rows) + ", " + std::to_string(columns) + "), }";
+	const size_t prefixLength = 10;
+	header.append(63 - (prefixLength + header.size()) % 64, ' ');
+	header += '\n';
+
+	const size_t headerLength = header.size();
+	const char prefix[prefixLength] = {
+		'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0, char(headerLength & 0xff), char((headerLength >> 8) & 0xff)
+	};
+	out.write(prefix, prefixLength);
+	out.write(header.data(), std::streamsize(headerLength));
+
+	for (size_t i = 0; i < size_t(rows) * columns; i++) {
+		char bytes[sizeof(float)];
+		std::memcpy(bytes, values + i, sizeof(float));
+		out.write(bytes, sizeof(float));
+	}
+
+	if (!out) {
+		throw std::runtime_error("could not write '" + filename + "'");
+	}
+}
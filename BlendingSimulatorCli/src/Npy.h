@@ -0,0 +1,13 @@
+#ifndef BLENDINGSIMULATOR_NPY_H
+#define BLENDINGSIMULATOR_NPY_H
+
+#include <string>
+#include <vector>
+
+// Reads a two dimensional little endian float32 or float64 array of a NumPy .npy file in row major order
+std::vector<float> readNpyMatrix(const std::string& filename, unsigned int& rows, unsigned int& columns);
+
+// Writes rows * columns floats in row major order as a two dimensional little endian float32 NumPy .npy file
+void writeNpyMatrix(const std::string& filename, const float* values, unsigned int rows, unsigned int columns);
+
+#endif
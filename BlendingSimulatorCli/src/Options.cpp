@@ -0,0 +1,126 @@
+#include "Options.h"
+
+#include <functional>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace bs = blendingsimulator;
+
+namespace
+{
+template<typename T>
+T parseValue(const std::string& value)
+{
+	std::istringstream stream(value);
+	T result;
+	if (!(stream >> result) || !stream.eof()) {
+		throw std::runtime_error("invalid value '" + value + "'");
+	}
+	return result;
+}
+
+// Same ranges as checked by the command line parser in main.cpp
+template<typename T>
+T parseValue(const std::string& value, T min, T max)
+{
+	const T result = parseValue<T>(value);
+	if (!(result >= min && result <= max)) {
+		std::ostringstream message;
+		message << "value '" << value << "' not in range [" << min << ", " << max << "]";
+		throw std::runtime_error(message.str());
+	}
+	return result;
+}
+
+bool parseFlag(const std::string& value)
+{
+	if (value == "1" || value == "true") {
+		return true;
+	} else if (value == "0" || value == "false") {
+		return false;
+	}
+	throw std::runtime_error("invalid flag '" + value + "'");
+}
+
+bs::ParticleShape parseShape(const std::string& value)
+{
+	if (value == "box") {
+		return bs::ParticleShape::Box;
+	} else if (value == "sphere") {
+		return bs::ParticleShape::Sphere;
+	} else if (value == "rollingsphere") {
+		return bs::ParticleShape::RollingSphere;
+	}
+	throw std::runtime_error("invalid shape '" + value + "'");
+}
+
+bs::DischargeFootprint parseFootprint(const std::string& value)
+{
+	if (value == "point") {
+		return bs::DischargeFootprint::Point;
+	} else if (value == "gaussian") {
+		return bs::DischargeFootprint::Gaussian;
+	} else if (value == "strip") {
+		return bs::DischargeFootprint::Strip;
+	}
+	throw std::runtime_error("invalid footprint '" + value + "'");
+}
+
+using Setter = std::function<void(RunConfiguration&, const std::string&)>;
+
+const std::map<std::string, Setter> options{
+	{"detailed", [](RunConfiguration& c, const std::string& v) { c.detailed = parseFlag(v); }},
+	{"circular", [](RunConfiguration& c, const std::string& v) { c.simulationParameters.circular = parseFlag(v); }},
+	{"length", [](RunConfiguration& c, const std::string& v) { c.simulationParameters.heapWorldSizeX = parseValue<float>(v, 0.0f, 1000000.0f); }},
+	{"depth", [](RunConfiguration& c, const std::string& v) { c.simulationParameters.heapWorldSizeZ = parseValue<float>(v, 0.0f, 1000000.0f); }},
+	{"reclaimangle", [](RunConfiguration& c, const std::string& v) { c.simulationParameters.reclaimAngle = parseValue<float>(v, 0.0f, 180.0f); }},
+	{"geometricreclaim", [](RunConfiguration& c, const std::string& v) { c.simulationParameters.geometricReclaim = parseFlag(v); }},
+	{"footprint", [](RunConfiguration& c, const std::string& v) { c.simulationParameters.dischargeFootprint = parseFootprint(v); }},
+	{"footprintx", [](RunConfiguration& c, const std::string& v) { c.simulationParameters.dischargeSizeX = parseValue<float>(v, 0.001f, 1000.0f); }},
+	{"footprintz", [](RunConfiguration& c, const std::string& v) { c.simulationParameters.dischargeSizeZ = parseValue<float>(v, 0.001f, 1000.0f); }},
+	{"eight", [](RunConfiguration& c, const std::string& v) { c.simulationParameters.eightLikelihood = parseValue<float>(v, 0.0f, 1.0f); }},
+	{"bulkdensity", [](RunConfiguration& c, const std::string& v) { c.simulationParameters.bulkDensityFactor = parseValue<float>(v, 0.001f, 1000.0f); }},
+	{"shape", [](RunConfiguration& c, const std::string& v) { c.simulationParameters.particleShape = parseShape(v); }},
+	{"ppm3", [](RunConfiguration& c, const std::string& v) { c.simulationParameters.particlesPerCubicMeter = parseValue<float>(v, 0.001f, 1000.0f); }},
+	{"dropheight", [](RunConfiguration& c, const std::string& v) { c.simulationParameters.dropHeight = parseValue<float>(v, 0.001f, 1000.0f); }},
+	{"partitions", [](RunConfiguration& c, const std::string& v) { c.simulationParameters.physicsPartitions = parseValue<unsigned int>(v, 1u, 1024u); }},
+	{"seed", [](RunConfiguration& c, const std::string& v) { c.simulationParameters.seed = parseValue<uint64_t>(v); }},
+	{"stream", [](RunConfiguration& c, const std::string& v) { c.simulationParameters.randomStream = parseValue<uint64_t>(v); }},
+	{"reclaimincrement", [](RunConfiguration& c, const std::string& v) { c.reclaimIncrement = parseValue<float>(v, 0.001f, 1000.0f); }},
+};
+}
+
+void applyOption(RunConfiguration& configuration, const std::string& name, const std::string& value)
+{
+	const auto it = options.find(name);
+	if (it == options.end()) {
+		throw std::runtime_error("unknown option '" + name + "'");
+	}
+	it->second(configuration, value);
+}
+
+void applyOption(RunConfiguration& configuration, const std::string& assignment)
+{
+	const size_t separator = assignment.find('=');
+	if (separator == std::string::npos) {
+		throw std::runtime_error("invalid option '" + assignment + "', expected <name>=<value>");
+	}
+	applyOption(configuration, assignment.substr(0, separator), assignment.substr(separator + 1));
+}
+
+std::string getSimulatorKey(const RunConfiguration& configuration)
+{
+	const bs::SimulationParameters& p = configuration.simulationParameters;
+	std::ostringstream key;
+	key << configuration.detailed << " " << p.heapWorldSizeX << " " << p.heapWorldSizeZ << " " << p.reclaimAngle
+		<< " " << p.particlesPerCubicMeter << " " << p.circular << " " << p.seed << " " << p.randomStream
+		<< " " << p.stackingQueueSize << " " << p.eightLikelihood << " " << p.visualize << " " << p.acceleratedDescent
+		<< " " << p.trackLayers << " " << p.geometricReclaim << " " << int(p.dischargeFootprint) << " " << p.dischargeSizeX
+		<< " " << p.dischargeSizeZ << " " << p.bulkDensityFactor << " " << int(p.particleShape) << " " << p.dropHeight
+		<< " " << p.physicsPartitions << " " << p.ballisticPreIntegration;
+	for (float angle : p.reclaimAngles) {
+		key << " " << angle;
+	}
+	return key.str();
+}
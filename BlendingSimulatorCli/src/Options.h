@@ -0,0 +1,25 @@
+#ifndef BLENDINGSIMULATOR_OPTIONS_H
+#define BLENDINGSIMULATOR_OPTIONS_H
+
+#include <string>
+
+#include "BlendingSimulator/SimulationParameters.h"
+
+// Everything a single simulation run can be configured with besides its input
+struct RunConfiguration
+{
+	bool detailed = false;
+	blendingsimulator::SimulationParameters simulationParameters;
+	float reclaimIncrement = 1.0f;
+};
+
+// Sets an option by its command line name without leading dashes, throws for unknown names or invalid values
+void applyOption(RunConfiguration& configuration, const std::string& name, const std::string& value);
+
+// Same as applyOption() for "<name>=<value>"
+void applyOption(RunConfiguration& configuration, const std::string& assignment);
+
+// Everything the constructed simulator depends on, equal keys allow reusing simulators
+std::string getSimulatorKey(const RunConfiguration& configuration);
+
+#endif
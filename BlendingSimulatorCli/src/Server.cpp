@@ -0,0 +1,206 @@
+#include "Server.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Execution.h"
+#include "Options.h"
+#include "WorkerPool.h"
+
+namespace bs = blendingsimulator;
+
+namespace
+{
+using Simulator = bs::BlendingSimulator<bs::AveragedParameters>;
+
+struct Job
+{
+	std::string id;
+	RunConfiguration configuration;
+	std::vector<std::string> lines;
+};
+
+// Idle simulators per configuration, cleared on release so that a job only pays for the simulation itself
+class SimulatorPool
+{
+	public:
+		explicit SimulatorPool(size_t maxIdle)
+			: maxIdle(maxIdle)
+			, idleCount(0)
+		{
+		}
+
+		std::unique_ptr<Simulator> acquire(const std::string& key, const Job& job)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				auto it = idle.find(key);
+				if (it != idle.end() && !it->second.empty()) {
+					std::unique_ptr<Simulator> simulator = std::move(it->second.back());
+					it->second.pop_back();
+					idleCount--;
+					return simulator;
+				}
+			}
+
+			return createSimulator(job.configuration.detailed, job.configuration.simulationParameters);
+		}
+
+		void release(const std::string& key, std::unique_ptr<Simulator> simulator)
+		{
+			simulator->clear();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (idleCount < maxIdle) {
+				idle[key].push_back(std::move(simulator));
+				idleCount++;
+			}
+		}
+
+	private:
+		const size_t maxIdle;
+		std::mutex mutex;
+		std::map<std::string, std::vector<std::unique_ptr<Simulator>>> idle;
+		size_t idleCount;
+};
+
+void startJob(Job& job, const std::string& header, const ExecutionParameters& parameters, const bs::SimulationParameters& simulationParameters)
+{
+	std::istringstream stream(header);
+	std::string keyword;
+	stream >> keyword >> job.id;
+	if (job.id.empty()) {
+		throw std::runtime_error("missing job id");
+	}
+
+	job.configuration.detailed = parameters.detailed;
+	job.configuration.simulationParameters = simulationParameters;
+	job.configuration.reclaimIncrement = parameters.reclaimIncrement;
+	job.lines.clear();
+
+	std::string option;
+	while (stream >> option) {
+		applyOption(job.configuration, option);
+	}
+}
+
+std::string runJob(const Job& job, SimulatorPool& pool)
+{
+	const std::string key = getSimulatorKey(job.configuration);
+	std::unique_ptr<Simulator> simulator = pool.acquire(key, job);
+
+	std::ostringstream out;
+	try {
+		int parameterCount = -1;
+		InputRecord record;
+		for (const std::string& line : job.lines) {
+			parseInputLine(line, parameterCount, record);
+			simulator->stack(record.x, record.z, bs::AveragedParameters(record.volume, record.values));
+		}
+		simulator->finishStacking();
+
+		out << "position\tvolume";
+		for (int i = 0; i < parameterCount; i++) {
+			out << "\tp_" << (i + 1);
+		}
+		out << "\n";
+
+		unsigned int rows = 1;
+		float position = 0.0f;
+		bs::AveragedParameters p;
+		while (!simulator->reclaimingFinished()) {
+			simulator->reclaimInto(position, p);
+
+			out << position << "\t" << p.getVolume();
+			for (int i = 0; i < parameterCount; i++) {
+				out << "\t" << p.getValue(i);
+			}
+			out << "\n";
+			rows++;
+
+			position += job.configuration.reclaimIncrement;
+		}
+
+		pool.release(key, std::move(simulator));
+		return "result " + job.id + " " + std::to_string(rows) + "\n" + out.str();
+	} catch (...) {
+		pool.release(key, std::move(simulator));
+		throw;
+	}
+}
+
+std::string formatError(const std::string& id, const std::string& message)
+{
+	std::string singleLine = message;
+	std::replace(singleLine.begin(), singleLine.end(), '\n', ' ');
+	return "error " + id + " " + singleLine + "\n";
+}
+}
+
+void serve(const ExecutionParameters& parameters, const bs::SimulationParameters& simulationParameters)
+{
+	const unsigned int workers = parameters.workers > 0 ? parameters.workers : std::max(1u, std::thread::hardware_concurrency());
+	std::cerr << "Serving jobs from stdin with " << workers << " workers" << std::endl;
+
+	std::mutex outputMutex;
+	auto write = [&outputMutex](const std::string& frame) {
+		std::lock_guard<std::mutex> lock(outputMutex);
+		std::cout << frame << std::flush;
+	};
+
+	SimulatorPool pool(4 * workers);
+	WorkerPool workerPool(workers);
+
+	std::unique_ptr<Job> job;
+	bool jobFailed = false;
+	std::string line;
+	while (std::getline(std::cin, line)) {
+		if (line.compare(0, 4, "job ") == 0) {
+			if (job && !jobFailed) {
+				write(formatError(job->id, "job not terminated by 'end'"));
+			}
+
+			job.reset(new Job());
+			jobFailed = false;
+			try {
+				startJob(*job, line, parameters, simulationParameters);
+			} catch (std::exception& e) {
+				write(formatError(job->id.empty() ? "-" : job->id, e.what()));
+				jobFailed = true;
+			}
+		} else if (line == "end") {
+			if (!job) {
+				write(formatError("-", "'end' outside of job"));
+			} else if (!jobFailed) {
+				std::shared_ptr<Job> submitted(std::move(job));
+				workerPool.submit([submitted, &pool, &write]() {
+					try {
+						write(runJob(*submitted, pool));
+					} catch (std::exception& e) {
+						write(formatError(submitted->id, e.what()));
+					}
+				});
+			}
+			job.reset();
+		} else if (job) {
+			if (!jobFailed) {
+				job->lines.push_back(line);
+			}
+		} else if (!line.empty()) {
+			write(formatError("-", "unexpected line '" + line + "' outside of job"));
+		}
+	}
+
+	if (job && !jobFailed) {
+		write(formatError(job->id, "job not terminated by 'end'"));
+	}
+
+	std::cerr << "Input closed, waiting for running jobs" << std::endl;
+}
@@ -0,0 +1,18 @@
+#ifndef BLENDINGSIMULATOR_SERVER_H
+#define BLENDINGSIMULATOR_SERVER_H
+
+#include "ExecutionParameters.h"
+#include "BlendingSimulator/SimulationParameters.h"
+
+// Reads framed jobs from stdin and writes framed results to stdout until stdin is closed
+//
+// Job:    job <id> [<option>=<value> ...]   options as on the command line without leading dashes
+//         <time> <x> <z> <volume> <values...>   same rows as in normal mode
+//         end
+// Result: result <id> <n>   followed by n lines of reclaim output including its header
+// Error:  error <id> <message>
+//
+// Results are written in order of completion, not submission
+void serve(const ExecutionParameters& parameters, const blendingsimulator::SimulationParameters& simulationParameters);
+
+#endif
@@ -0,0 +1,216 @@
+#include "Sweep.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "Execution.h"
+#include "Options.h"
+
+namespace bs = blendingsimulator;
+
+namespace
+{
+struct SweepDimension
+{
+	std::string name;
+	std::vector<std::string> values;
+};
+
+// Material is spread from (x0, z0) to (x, z), both coincide unless stacker paths are read
+struct TraceRecord
+{
+	float x0;
+	float z0;
+	float x;
+	float z;
+	bs::AveragedParameters parameters;
+};
+
+SweepDimension parseSweep(const std::string& sweep)
+{
+	const size_t separator = sweep.find('=');
+	if (separator == std::string::npos || separator == 0) {
+		throw std::runtime_error("invalid sweep '" + sweep + "', expected <option>=<values>");
+	}
+
+	SweepDimension dimension;
+	dimension.name = sweep.substr(0, separator);
+	const std::string values = sweep.substr(separator + 1);
+
+	if (std::count(values.begin(), values.end(), ':') == 2) {
+		double first;
+		double last;
+		double step;
+		char colon1;
+		char colon2;
+		std::istringstream stream(values);
+		if (!(stream >> first >> colon1 >> last >> colon2 >> step) || !stream.eof() || step <= 0.0 || last < first) {
+			throw std::runtime_error("invalid range '" + values + "', expected <first>:<last>:<step>");
+		}
+
+		const auto count = static_cast<unsigned int>(std::floor((last - first) / step + 1e-9)) + 1;
+		for (unsigned int i = 0; i < count; i++) {
+			std::ostringstream value;
+			value << first + i * step;
+			dimension.values.push_back(value.str());
+		}
+	} else {
+		std::istringstream stream(values);
+		std::string value;
+		while (std::getline(stream, value, ',')) {
+			dimension.values.push_back(value);
+		}
+	}
+
+	if (dimension.values.empty()) {
+		throw std::runtime_error("sweep '" + sweep + "' has no values");
+	}
+
+	// Fail before reading the trace if any value is invalid
+	RunConfiguration configuration;
+	for (const std::string& value : dimension.values) {
+		applyOption(configuration, dimension.name, value);
+	}
+
+	return dimension;
+}
+
+std::string runPoint(const RunConfiguration& configuration, const std::vector<TraceRecord>& trace, const std::string& label, int parameterCount)
+{
+	const auto simulator = createSimulator(configuration.detailed, configuration.simulationParameters);
+	for (const TraceRecord& record : trace) {
+		simulator->stackAlong(record.x0, record.z0, record.x, record.z, record.parameters);
+	}
+	simulator->finishStacking();
+
+	std::ostringstream out;
+	float position = 0.0f;
+	bs::AveragedParameters p;
+	while (!simulator->reclaimingFinished()) {
+		simulator->reclaimInto(position, p);
+
+		out << label << position << "\t" << p.getVolume();
+		for (int i = 0; i < parameterCount; i++) {
+			out << "\t" << p.getValue(i);
+		}
+		out << "\n";
+
+		position += configuration.reclaimIncrement;
+	}
+
+	return out.str();
+}
+}
+
+void runSweep(const ExecutionParameters& parameters, const bs::SimulationParameters& simulationParameters, const std::vector<std::string>& sweeps)
+{
+	std::vector<SweepDimension> dimensions;
+	size_t pointCount = 1;
+	for (const std::string& sweep : sweeps) {
+		dimensions.push_back(parseSweep(sweep));
+		pointCount *= dimensions.back().values.size();
+	}
+
+	std::cerr << "Reading stacking trace from stdin" << std::endl;
+
+	std::vector<TraceRecord> trace;
+	std::string line;
+	int parameterCount = -1;
+	InputRecord record;
+	InputPath path;
+	while (std::getline(std::cin, line)) {
+		try {
+			parseInputLine(line, parameterCount, record);
+			float x0 = record.x;
+			float z0 = record.z;
+			if (parameters.pathInput) {
+				path.advance(record, x0, z0);
+			}
+			trace.push_back({x0, z0, record.x, record.z, bs::AveragedParameters(record.volume, record.values)});
+		} catch (std::exception& e) {
+			std::cerr << "could not match line '" << line << "': " << e.what() << std::endl;
+		}
+	}
+
+	const unsigned int workers = static_cast<unsigned int>(std::min<size_t>(
+		pointCount,
+		parameters.workers > 0 ? parameters.workers : std::max(1u, std::thread::hardware_concurrency())
+	));
+	std::cerr << "Sweeping " << pointCount << " points over " << trace.size() << " records with " << workers << " workers" << std::endl;
+
+	// Points are handed out one at a time so that slow points do not hold back a whole share of the work
+	std::vector<std::string> results(pointCount);
+	std::atomic<size_t> nextPoint(0);
+	std::atomic<size_t> finishedPoints(0);
+	std::mutex logMutex;
+	auto work = [&]() {
+		for (size_t point = nextPoint++; point < pointCount; point = nextPoint++) {
+			RunConfiguration configuration;
+			configuration.detailed = parameters.detailed;
+			configuration.simulationParameters = simulationParameters;
+			configuration.reclaimIncrement = parameters.reclaimIncrement;
+
+			// Last dimension varies fastest
+			std::string label;
+			size_t remainder = point;
+			for (size_t d = dimensions.size(); d-- > 0;) {
+				const std::string& value = dimensions[d].values[remainder % dimensions[d].values.size()];
+				remainder /= dimensions[d].values.size();
+				applyOption(configuration, dimensions[d].name, value);
+				label.insert(0, value + "\t");
+			}
+
+			try {
+				results[point] = runPoint(configuration, trace, label, parameterCount);
+			} catch (std::exception& e) {
+				std::lock_guard<std::mutex> lock(logMutex);
+				std::cerr << "Point " << label << "failed: " << e.what() << std::endl;
+			}
+
+			if (parameters.verbose) {
+				std::lock_guard<std::mutex> lock(logMutex);
+				std::cerr << "Finished point " << ++finishedPoints << " of " << pointCount << std::endl;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned int i = 1; i < workers; i++) {
+		threads.emplace_back(work);
+	}
+	work();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	const std::string filename = parameters.reclaimFile.empty() ? "stdout" : parameters.reclaimFile;
+	std::cerr << "Writing sweep results into '" << filename << "'" << std::endl;
+
+	std::ofstream of;
+	std::ostream out(openOutput(filename, of));
+	if (!out) {
+		throw std::runtime_error("could not open output file stream for filename '" + filename + "'");
+	}
+
+	for (const SweepDimension& dimension : dimensions) {
+		out << dimension.name << "\t";
+	}
+	out << "position\tvolume";
+	for (int i = 0; i < parameterCount; i++) {
+		out << "\tp_" << (i + 1);
+	}
+	out << "\n";
+
+	for (const std::string& result : results) {
+		out << result;
+	}
+	out.flush();
+
+	std::cerr << "Sweep finished" << std::endl;
+}
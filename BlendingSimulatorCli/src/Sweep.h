@@ -0,0 +1,19 @@
+#ifndef BLENDINGSIMULATOR_SWEEP_H
+#define BLENDINGSIMULATOR_SWEEP_H
+
+#include <string>
+#include <vector>
+
+#include "ExecutionParameters.h"
+#include "BlendingSimulator/SimulationParameters.h"
+
+// Stacks the trace read once from stdin for every combination of swept option values in parallel
+// Sweeps are given as <option>=<first>:<last>:<step> or <option>=<value>,<value>,... with option names as on the command line
+// Writes a single reclaim table into the reclaim file or stdout with one leading column per swept option
+void runSweep(
+	const ExecutionParameters& parameters,
+	const blendingsimulator::SimulationParameters& simulationParameters,
+	const std::vector<std::string>& sweeps
+);
+
+#endif
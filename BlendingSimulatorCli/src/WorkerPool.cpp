@@ -0,0 +1,57 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned int threadCount)
+	: stopping(false)
+{
+	threadCount = std::max(1u, threadCount);
+	for (unsigned int i = 0; i < threadCount; i++) {
+		threads.emplace_back(&WorkerPool::run, this);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	taskAvailable.notify_all();
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+void WorkerPool::submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	taskAvailable.notify_one();
+}
+
+void WorkerPool::run()
+{
+	while (true) {
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			taskAvailable.wait(lock, [this]() {
+				return stopping || !tasks.empty();
+			});
+
+			if (tasks.empty()) {
+				return;
+			}
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		task();
+	}
+}
@@ -0,0 +1,32 @@
+#ifndef BLENDINGSIMULATOR_WORKERPOOL_H
+#define BLENDINGSIMULATOR_WORKERPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads executing submitted tasks in submission order
+class WorkerPool
+{
+	public:
+		explicit WorkerPool(unsigned int threadCount);
+
+		// Waits for all submitted tasks to finish
+		~WorkerPool();
+
+		void submit(std::function<void()> task);
+
+	private:
+		std::mutex mutex;
+		std::condition_variable taskAvailable;
+		std::deque<std::function<void()>> tasks;
+		bool stopping;
+		std::vector<std::thread> threads;
+
+		void run();
+};
+
+#endif
@@ -1,9 +1,14 @@
 #include <iostream>
+#include <map>
+#include <stdexcept>
 
 #include <CLI/CLI.hpp>
 
 #include "Execution.h"
+#include "Server.h"
+#include "Sweep.h"
 #include "BlendingSimulator/SimulationParameters.h"
+#include "BlendingSimulator/Tracing.h"
 
 int main(const int argc, char* argv[]) try
 {
@@ -36,14 +41,44 @@ int main(const int argc, char* argv[]) try
 		->default_val(simulationParameters.reclaimAngle)
 		->group("Simulation Options")
 		->check(CLI::Range(0.0f, 180.0f));
+	app.add_option("--reclaimangles", simulationParameters.reclaimAngles, "Comma separated reclaimer angles evaluated in one stacking pass (fast simulation)")
+		->delimiter(',')
+		->group("Simulation Options")
+		->check(CLI::Range(0.0f, 180.0f));
 	app.add_option("--eight", simulationParameters.eightLikelihood, "Likelihood of 8 vs 4 sides being considered")
 		->default_val(simulationParameters.eightLikelihood)
 		->group("Simulation Options")
 		->check(CLI::Range(0.0f, 1.0f));
+	const std::map<std::string, blendingsimulator::DischargeFootprint> footprintNames{
+		{"point", blendingsimulator::DischargeFootprint::Point},
+		{"gaussian", blendingsimulator::DischargeFootprint::Gaussian},
+		{"strip", blendingsimulator::DischargeFootprint::Strip}
+	};
+	app.add_option("--footprint", simulationParameters.dischargeFootprint, "Discharge footprint around the stacker position (fast simulation)")
+		->default_str("point")
+		->group("Simulation Options")
+		->transform(CLI::CheckedTransformer(footprintNames, CLI::ignore_case));
+	app.add_option("--footprintx", simulationParameters.dischargeSizeX, "Discharge footprint size along x, standard deviation of gaussian footprints")
+		->default_val(simulationParameters.dischargeSizeX)
+		->group("Simulation Options")
+		->check(CLI::Range(0.001f, 1000.0f));
+	app.add_option("--footprintz", simulationParameters.dischargeSizeZ, "Discharge footprint size along z, standard deviation of gaussian footprints")
+		->default_val(simulationParameters.dischargeSizeZ)
+		->group("Simulation Options")
+		->check(CLI::Range(0.001f, 1000.0f));
 	app.add_option("--bulkdensity", simulationParameters.bulkDensityFactor, "Factor for bulk density determination")
 		->default_val(simulationParameters.bulkDensityFactor)
 		->group("Simulation Options")
 		->check(CLI::Range(0.001f, 1000.0f));
+	const std::map<std::string, blendingsimulator::ParticleShape> shapeNames{
+		{"box", blendingsimulator::ParticleShape::Box},
+		{"sphere", blendingsimulator::ParticleShape::Sphere},
+		{"rollingsphere", blendingsimulator::ParticleShape::RollingSphere}
+	};
+	app.add_option("--shape", simulationParameters.particleShape, "Particle shape in detailed simulation")
+		->default_str("box")
+		->group("Simulation Options")
+		->transform(CLI::CheckedTransformer(shapeNames, CLI::ignore_case));
 	app.add_option("--ppm3", simulationParameters.particlesPerCubicMeter, "Amount of particles per cubic meter")
 		->default_val(simulationParameters.particlesPerCubicMeter)
 		->group("Simulation Options")
@@ -52,11 +87,30 @@ int main(const int argc, char* argv[]) try
 		->default_val(simulationParameters.dropHeight)
 		->group("Simulation Options")
 		->check(CLI::Range(0.001f, 1000.0f));
+	app.add_option("--partitions", simulationParameters.physicsPartitions, "Amount of physics worlds stepped in parallel in detailed simulation")
+		->default_val(simulationParameters.physicsPartitions)
+		->group("Simulation Options")
+		->check(CLI::Range(1u, 1024u));
+	app.add_option("--seed", simulationParameters.seed, "Random seed for reproducible results, 0 for a random seed")
+		->default_val(simulationParameters.seed)
+		->group("Simulation Options");
+	app.add_option("--stream", simulationParameters.randomStream, "Random stream derived from the seed, e.g. replicate number")
+		->default_val(simulationParameters.randomStream)
+		->group("Simulation Options");
 	app.add_option("--reclaimincrement", executionParameters.reclaimIncrement, "Reclaimer position increment")
 		->default_val(executionParameters.reclaimIncrement)
 		->group("Simulation Options")
 		->check(CLI::Range(0.001f, 1000.0f));
 
+	// Parallel Execution Options
+	app.add_flag("--serve", executionParameters.serve, "Run framed jobs from stdin reusing simulators, see Server.h for the protocol")
+		->group("Parallel Execution Options");
+	app.add_option("--sweep", executionParameters.sweeps, "Simulate every combination of option values given as <option>=<first>:<last>:<step> or <option>=<value>,<value>")
+		->group("Parallel Execution Options");
+	app.add_option("--workers", executionParameters.workers, "Amount of jobs or sweep points executed concurrently, 0 for one per core")
+		->default_val(executionParameters.workers)
+		->group("Parallel Execution Options");
+
 #ifdef VISUALIZER_AVAILABLE
 	// Visualization Options
 	app.add_flag("--visualize", executionParameters.visualize, "Show visualization")
@@ -66,10 +120,27 @@ int main(const int argc, char* argv[]) try
 #endif
 
 	// Input / Output Options
-	app.add_option("--heights", executionParameters.heightsFile, "Height map output file")
+	app.add_flag("--pathinput", executionParameters.pathInput, "Input rows describe the stacker path, the volume of a row is spread evenly from the previous position")
+		->group("Input / Output Options");
+	auto initialHeightsOption = app.add_option("--initialheights", executionParameters.initialHeightsFile, "Heights in m to start from as float .npy array with one row per z cell like the height map output, e.g. left over from a previous cycle (fast simulation)")
+		->group("Input / Output Options")
+		->check(CLI::ExistingFile);
+	app.add_option("--initialcomposition", executionParameters.initialComposition, "Comma separated parameters of the initial material which is then reclaimed along with the stacked material, inert otherwise")
+		->delimiter(',')
+		->group("Input / Output Options")
+		->needs(initialHeightsOption);
+	app.add_option("--heights", executionParameters.heightsFile, "Height map output file, tab separated or float .npy for names ending in .npy which --initialheights can load")
 		->group("Input / Output Options");
 	app.add_option("--reclaim", executionParameters.reclaimFile, "Reclaim output file")
 		->group("Input / Output Options");
+	app.add_option("--metrics", executionParameters.metricsFile, "Blending quality metrics output file")
+		->group("Input / Output Options");
+	app.add_flag("--streamreclaim", executionParameters.streamReclaim, "Write reclaim rows as soon as the stacker can no longer change them, assumes a stacker moving along the bed (linear fast simulation)")
+		->group("Input / Output Options");
+	app.add_option("--depositlog", simulationParameters.depositLogFile, "Binary log of every deposited particle")
+		->group("Input / Output Options");
+	app.add_option("--trace", executionParameters.traceFile, "Chrome trace of the simulation stages, requires a build with ENABLE_TRACING")
+		->group("Input / Output Options");
 
 	try {
 		app.parse(argc, argv);
@@ -83,7 +154,42 @@ int main(const int argc, char* argv[]) try
 #ifdef VISUALIZER_AVAILABLE
 	simulationParameters.visualize = executionParameters.visualize;
 #endif
-	executeSimulation(executionParameters, simulationParameters);
+	if ((executionParameters.serve || !executionParameters.sweeps.empty()) && !simulationParameters.depositLogFile.empty()) {
+		throw std::runtime_error("deposit log is only supported for single simulations");
+	}
+
+	if ((executionParameters.serve || !executionParameters.sweeps.empty()) && !executionParameters.initialHeightsFile.empty()) {
+		throw std::runtime_error("initial heights are only supported for single simulations");
+	}
+
+	if (executionParameters.serve && executionParameters.pathInput) {
+		throw std::runtime_error("path input is not supported in server mode");
+	}
+
+	if (!executionParameters.traceFile.empty()) {
+		if (executionParameters.serve || !executionParameters.sweeps.empty()) {
+			throw std::runtime_error("trace output is only supported for single simulations");
+		}
+		if (!blendingsimulator::tracing::enabled) {
+			std::cerr << "Tracing is not enabled in this build, the trace will be empty" << std::endl;
+		}
+	}
+
+	if (executionParameters.streamReclaim && simulationParameters.circular) {
+		throw std::runtime_error("streaming reclaim is only supported for linear beds");
+	}
+
+	if (executionParameters.streamReclaim && executionParameters.detailed) {
+		throw std::runtime_error("streaming reclaim is only supported in fast simulation");
+	}
+
+	if (executionParameters.serve) {
+		serve(executionParameters, simulationParameters);
+	} else if (!executionParameters.sweeps.empty()) {
+		runSweep(executionParameters, simulationParameters, executionParameters.sweeps);
+	} else {
+		executeSimulation(executionParameters, simulationParameters);
+	}
 } catch (std::exception& e) {
 	std::cerr << e.what() << std::endl;
 	return 1;
@@ -0,0 +1,102 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include "BlendingSimulator/AllocationAccounting.h"
+#include "BlendingSimulator/BlendingSimulatorDetailed.h"
+#include "BlendingSimulator/ParticleParameters.h"
+
+#ifdef BLENDINGSIMULATOR_ALLOCATION_ACCOUNTING
+
+#include "BlendingSimulator/AllocationInterposer.h"
+
+#endif
+
+namespace bs = blendingsimulator;
+
+struct ShapeResult
+{
+	double seconds;
+	double particlesPerSecond;
+	double heapAngle;
+	double allocationsPerParticle[bs::allocation::phaseCount];
+};
+
+// Estimate the angle of repose from the cone formed by stacking onto a single spot
+double estimateHeapAngle(bs::BlendingSimulator<bs::AveragedParameters>& simulator)
+{
+	const std::pair<unsigned int, unsigned int> heapMapSize = simulator.getHeapMapSize();
+	const std::pair<float, float> heapWorldSize = simulator.getHeapWorldSize();
+	const float* heapMap = simulator.getHeapMap();
+
+	const double cellArea = heapWorldSize.first / heapMapSize.first * heapWorldSize.second / heapMapSize.second;
+	double maxHeight = 0.0;
+	double coveredArea = 0.0;
+	for (unsigned int i = 0; i < heapMapSize.first * heapMapSize.second; i++) {
+		maxHeight = std::max(maxHeight, double(heapMap[i]));
+		if (heapMap[i] > 0.0f) {
+			coveredArea += cellArea;
+		}
+	}
+
+	const double radius = std::sqrt(coveredArea / 3.141592653589793238463);
+	return radius > 0.0 ? std::atan(maxHeight / radius) * 180.0 / 3.141592653589793238463 : 0.0;
+}
+
+ShapeResult runShape(bs::ParticleShape shape, double volume)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 20.0f;
+	simulationParameters.heapWorldSizeZ = 20.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.particleShape = shape;
+
+	bs::BlendingSimulatorDetailed<bs::AveragedParameters> simulator(simulationParameters);
+
+	bs::allocation::reset();
+	const auto start = std::chrono::steady_clock::now();
+	simulator.stack(10.0f, 15.0f, bs::AveragedParameters(volume, {1.0}));
+	simulator.finishStacking();
+	const auto end = std::chrono::steady_clock::now();
+
+	ShapeResult result{};
+	result.seconds = std::chrono::duration<double>(end - start).count();
+	result.particlesPerSecond = volume * simulationParameters.particlesPerCubicMeter / result.seconds;
+	result.heapAngle = estimateHeapAngle(simulator);
+	for (size_t i = 0; i < bs::allocation::phaseCount; i++) {
+		const double particles = volume * simulationParameters.particlesPerCubicMeter;
+		result.allocationsPerParticle[i] = double(bs::allocation::getCounters(static_cast<bs::allocation::Phase>(i)).count) / particles;
+	}
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	const double volume = argc > 1 ? std::stod(argv[1]) : 500.0;
+
+	const std::pair<bs::ParticleShape, const char*> shapes[] = {
+		{bs::ParticleShape::Box, "box"},
+		{bs::ParticleShape::Sphere, "sphere"},
+		{bs::ParticleShape::RollingSphere, "rollingsphere"}
+	};
+
+	std::cout << "shape\tseconds\tparticles_per_second\theap_angle";
+	if (bs::allocation::enabled) {
+		for (size_t i = 0; i < bs::allocation::phaseCount; i++) {
+			std::cout << "\t" << bs::allocation::getPhaseName(static_cast<bs::allocation::Phase>(i)) << "_allocations_per_particle";
+		}
+	}
+	std::cout << std::endl;
+	for (const auto& shape : shapes) {
+		ShapeResult result = runShape(shape.first, volume);
+		std::cout << shape.second << "\t" << result.seconds << "\t" << result.particlesPerSecond << "\t" << result.heapAngle;
+		if (bs::allocation::enabled) {
+			for (double allocations : result.allocationsPerParticle) {
+				std::cout << "\t" << allocations;
+			}
+		}
+		std::cout << std::endl;
+	}
+
+	return 0;
+}
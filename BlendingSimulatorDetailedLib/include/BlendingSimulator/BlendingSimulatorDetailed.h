@@ -7,6 +7,8 @@
 #include <map>
 #include <mutex>
 #include <atomic>
+#include <condition_variable>
+#include <thread>
 
 // Bullet
 #include <LinearMath/btVector3.h>
@@ -44,6 +46,8 @@ class btRigidBody;
 
 class btDiscreteDynamicsWorld;
 
+class btTransform;
+
 // Local
 #include "BlendingSimulator/BlendingSimulator.h"
 
@@ -65,7 +69,10 @@ class BlendingSimulatorDetailed : public BlendingSimulator<Parameters>
 		void clear() override;
 		void finishStacking() override;
 		bool reclaimingFinished() override;
-		Parameters reclaim(float position) override;
+		void reclaimInto(float position, Parameters& out) override;
+
+		using BlendingSimulator<Parameters>::reclaimingFinished;
+		using BlendingSimulator<Parameters>::reclaimInto;
 
 	protected:
 		void stackSingle(float x, float z, const Parameters& parameters) override;
@@ -82,29 +89,89 @@ class BlendingSimulatorDetailed : public BlendingSimulator<Parameters>
 		static const int maxFreezeTimeout = 25000;
 		static const unsigned long long simulationIntervalMs = 30;
 		static const int simulationIntervalSubSteps = 3;
+		static constexpr const float linearDamping = 0.1f;
+		static constexpr const float ballisticMarginFactor = 2.0f; // Particle sizes above surface at which falling particles enter physics
+		static constexpr const float ghostZoneFactor = 3.0f; // Particle sizes by which particles are mirrored into neighbor partitions
+		static constexpr const float depositPositionScale = 0.001f; // Deposit log resolution in m
+		static constexpr const float boxPackingFraction = 0.67f; // Solid share of a poured heap of boxes
+		static constexpr const float spherePackingFraction = 0.60f; // Solid share of a poured heap of spheres
+
+		// Independent physics world simulating a strip of the bed along X
+		struct PhysicsPartition
+		{
+			btBroadphaseInterface* broadphase;
+			btDefaultCollisionConfiguration* collisionConfiguration;
+			btCollisionDispatcher* dispatcher;
+			btSequentialImpulseConstraintSolver* solver;
+			btDefaultMotionState* groundMotionState;
+			btRigidBody* groundRigidBody;
+			btDiscreteDynamicsWorld* dynamicsWorld;
+		};
+
+		// Particle on its way from the stacker to the heap, integrated outside of the physics engine
+		struct BallisticParticle
+		{
+			btVector3 position;
+			btVector3 velocity;
+			btQuaternion rotation;
+			btVector3 size;
+			Parameters parameters;
+			unsigned long long creationTickCount;
+			Particle<Parameters>* outputParticle; // Only with visualization, handed over to the particle entering physics
+		};
 
 		std::mutex simulationMutex;
 		std::deque<ParticleDetailed<Parameters>*> activeParticles;
 		std::atomic_bool activeParticlesAvailable;
 		std::deque<ParticleDetailed<Parameters>*> allParticles;
+		std::vector<BallisticParticle> ballisticParticles;
+
+		// Top of not yet frozen particles per heap map cell, only maintained while ballistic particles exist
+		std::vector<float> activeSurface;
+		std::vector<unsigned int> activeSurfaceCells;
 
 		const float particleSize; // In m cube side length
+		const float shapeSize; // In m side length or diameter of a particle filling the same bulk volume as a particleSize cube
 		const float resolutionPerWorldSize; // Cells per meter
 
 		const unsigned long long simulationTicksPerParticle;
 		unsigned long long simulationTickCount;
 		unsigned long long nextParticleTickCount;
+		int optimizeFrozenParticlesCounter; // Steps since frozen particles were last optimized
+
+		const float partitionWidth; // In m along X
+		const float ghostZoneWidth; // In m along X
 
-		btBroadphaseInterface* broadphase;
-		btDefaultCollisionConfiguration* collisionConfiguration;
-		btCollisionDispatcher* dispatcher;
-		btSequentialImpulseConstraintSolver* solver;
 		btCollisionShape* groundShape;
-		btDefaultMotionState* groundMotionState;
-		btRigidBody* groundRigidBody;
-		btDiscreteDynamicsWorld* dynamicsWorld;
+		std::vector<PhysicsPartition> partitions;
+
+		// Workers stepping all partitions but the first, which is stepped by the simulation thread
+		std::vector<std::thread> partitionWorkers;
+		std::mutex partitionWorkersMutex;
+		std::condition_variable partitionStepStarted;
+		std::condition_variable partitionStepFinished;
+		unsigned long long partitionStepCount;
+		unsigned int pendingPartitionSteps;
+		float partitionTimeStep;
+		bool partitionWorkersStopping;
 
 		void step();
+		void stepPartition(PhysicsPartition& partition, float timeStep);
+		void stepPartitions(float timeStep);
+		void runPartitionWorker(unsigned int partitionIndex);
+		void stopPartitionWorkers();
+		static float getPackingCorrection(ParticleShape shape);
+		void migrateParticles();
+		unsigned int getPartitionIndex(float x);
+		bool isInGhostZone(unsigned int partitionIndex, float x) const;
+		void updateGhosts(ParticleDetailed<Parameters>* particle, const btTransform& trans);
+		void removeGhosts(ParticleDetailed<Parameters>* particle);
+		void addGhosts(ParticleDetailed<Parameters>* particle, const btTransform& trans);
+		void removeFromSimulation(ParticleDetailed<Parameters>* particle);
+		void advanceBallisticParticles();
+		void updateActiveSurface();
+		float getSurfaceHeight(const btVector3& position);
+		unsigned int getHeapMapIndex(float x, float z);
 		void doOutputParticles();
 		void freezeParticles();
 		void freezeParticle(ParticleDetailed<Parameters>* particle);
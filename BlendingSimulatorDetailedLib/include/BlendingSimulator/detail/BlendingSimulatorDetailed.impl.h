@@ -1,6 +1,6 @@
-#include <random>
 #include <thread>
 #include <algorithm>
+#include <functional>
 
 // Bullet
 #include <btBulletDynamicsCommon.h>
@@ -12,50 +12,88 @@ template<typename Parameters>
 blendingsimulator::BlendingSimulatorDetailed<Parameters>::BlendingSimulatorDetailed(SimulationParameters simulationParameters)
 	: BlendingSimulator<Parameters>(simulationParameters)
 	, particleSize(std::pow(simulationParameters.bulkDensityFactor / simulationParameters.particlesPerCubicMeter, 1.0f / 3.0f))
+	, shapeSize(simulationParameters.particleShape == ParticleShape::Box
+		? particleSize
+		: particleSize * std::cbrt(6.0f / float(BlendingSimulator<Parameters>::pi) * getPackingCorrection(simulationParameters.particleShape)))
 	, resolutionPerWorldSize(1.0f / particleSize)
 	, simulationTicksPerParticle((unsigned long long)(1000.0 * std::pow(particleSize, 3.0) / cubicMetersPerSecond))
 	, simulationTickCount(0)
 	, nextParticleTickCount(0)
+	, optimizeFrozenParticlesCounter(0)
 	, activeParticlesAvailable(false)
+	, partitionWidth(simulationParameters.heapWorldSizeX / float(std::max(1u, simulationParameters.physicsPartitions)))
+	, ghostZoneWidth(ghostZoneFactor * particleSize)
+	, partitionStepCount(0)
+	, pendingPartitionSteps(0)
+	, partitionTimeStep(0.0f)
+	, partitionWorkersStopping(false)
 {
 	this->initializeHeapMap(
 		(unsigned int)(simulationParameters.heapWorldSizeX / particleSize + 0.5) + 1,
 		(unsigned int)(simulationParameters.heapWorldSizeZ / particleSize + 0.5) + 1
 	);
+	activeSurface.resize(this->heapSizeX * this->heapSizeZ, 0.0f);
 
-	// Initialize physics
-	collisionConfiguration = new btDefaultCollisionConfiguration();
-	dispatcher = new btCollisionDispatcher(collisionConfiguration);
-	broadphase = new btDbvtBroadphase();
-	solver = new btSequentialImpulseConstraintSolver;
-	dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collisionConfiguration);
-	dynamicsWorld->setGravity(btVector3(0, -9.80665f, 0));
-
-	// Static ground shape
+	// Static ground shape shared by all partitions
 	groundShape = new btStaticPlaneShape(btVector3(0, 1, 0), 1);
-	groundMotionState = new btDefaultMotionState(btTransform(btQuaternion(0, 0, 0, 1), btVector3(0, -1, 0)));
-	btRigidBody::btRigidBodyConstructionInfo groundRigidBodyCI(0, groundMotionState, groundShape, btVector3(0, 0, 0));
-	groundRigidBodyCI.m_friction = 10;
-	groundRigidBody = new btRigidBody(groundRigidBodyCI);
-	dynamicsWorld->addRigidBody(groundRigidBody);
+
+	// Initialize physics
+	partitions.resize(std::max(1u, simulationParameters.physicsPartitions));
+	for (PhysicsPartition& partition : partitions) {
+		partition.collisionConfiguration = new btDefaultCollisionConfiguration();
+		partition.dispatcher = new btCollisionDispatcher(partition.collisionConfiguration);
+		partition.broadphase = new btDbvtBroadphase();
+		partition.solver = new btSequentialImpulseConstraintSolver;
+		partition.dynamicsWorld = new btDiscreteDynamicsWorld(partition.dispatcher, partition.broadphase, partition.solver,
+			partition.collisionConfiguration);
+		partition.dynamicsWorld->setGravity(btVector3(0, -9.80665f, 0));
+
+		partition.groundMotionState = new btDefaultMotionState(btTransform(btQuaternion(0, 0, 0, 1), btVector3(0, -1, 0)));
+		btRigidBody::btRigidBodyConstructionInfo groundRigidBodyCI(0, partition.groundMotionState, groundShape, btVector3(0, 0, 0));
+		groundRigidBodyCI.m_friction = 10;
+		partition.groundRigidBody = new btRigidBody(groundRigidBodyCI);
+		partition.dynamicsWorld->addRigidBody(partition.groundRigidBody);
+	}
+
+	// Workers live as long as the simulator instead of being started for every step
+	for (unsigned int i = 1; i < partitions.size(); i++) {
+		partitionWorkers.emplace_back(&BlendingSimulatorDetailed<Parameters>::runPartitionWorker, this, i);
+	}
+
+	this->openDepositLog(depositPositionScale);
+}
+
+// Solid volume of a particle relative to a box filling the same bulk volume of a heap
+template<typename Parameters>
+float blendingsimulator::BlendingSimulatorDetailed<Parameters>::getPackingCorrection(ParticleShape shape)
+{
+	return shape == ParticleShape::Box ? 1.0f : spherePackingFraction / boxPackingFraction;
 }
 
 template<typename Parameters>
 blendingsimulator::BlendingSimulatorDetailed<Parameters>::~BlendingSimulatorDetailed()
 {
+	this->stopStackingWorker();
+	stopPartitionWorkers();
 	clear();
 
 	std::lock_guard<std::mutex> lock(simulationMutex);
 
-	// Ground
-	dynamicsWorld->removeRigidBody(groundRigidBody);
-	delete groundRigidBody->getMotionState();
-	delete groundRigidBody;
-	delete groundShape;
+	for (PhysicsPartition& partition : partitions) {
+		// Ground
+		partition.dynamicsWorld->removeRigidBody(partition.groundRigidBody);
+		delete partition.groundRigidBody;
+		delete partition.groundMotionState;
+
+		// Physics
+		delete partition.dynamicsWorld;
+		delete partition.solver;
+		delete partition.broadphase;
+		delete partition.dispatcher;
+		delete partition.collisionConfiguration;
+	}
 
-	// Physics
-	delete dynamicsWorld;
-	delete solver;
+	delete groundShape;
 }
 
 template<typename Parameters>
@@ -63,6 +101,8 @@ void blendingsimulator::BlendingSimulatorDetailed<Parameters>::clear()
 {
 	std::lock_guard<std::mutex> lock(simulationMutex);
 	simulationTickCount = 0;
+	optimizeFrozenParticlesCounter = 0;
+	this->resetStacking();
 
 	for (int z = 0; z < this->heapSizeZ; z++) {
 		for (int x = 0; x < this->heapSizeX; x++) {
@@ -77,10 +117,19 @@ void blendingsimulator::BlendingSimulatorDetailed<Parameters>::clear()
 	}
 
 	activeParticles.clear();
+	for (BallisticParticle& particle : ballisticParticles) {
+		delete particle.outputParticle;
+	}
+	ballisticParticles.clear();
+
+	for (unsigned int cell : activeSurfaceCells) {
+		activeSurface[cell] = 0.0f;
+	}
+	activeSurfaceCells.clear();
 
 	// TODO: This takes forever!
 	while (!allParticles.empty()) {
-		dynamicsWorld->removeRigidBody(allParticles.back()->rigidBody);
+		removeFromSimulation(allParticles.back());
 
 		delete allParticles.back();
 		allParticles.pop_back();
@@ -99,10 +148,19 @@ blendingsimulator::BlendingSimulatorDetailed<Parameters>::createParticle(btVecto
 	particle->creationTickCount = simulationTickCount;
 	particle->size = size;
 
-	particle->collisionShape = new btBoxShape(0.5 * particle->size);
+	const ParticleShape shape = this->simulationParameters.particleShape;
+	btScalar volume;
+	if (shape == ParticleShape::Box) {
+		particle->collisionShape = new btBoxShape(0.5 * particle->size);
+		volume = size.x() * size.y() * size.z();
+	} else {
+		particle->collisionShape = new btSphereShape(0.5 * particle->size.x());
+		volume = btScalar(this->pi / 6.0) * size.x() * size.x() * size.x();
+	}
 	particle->defaultMotionState = new btDefaultMotionState(btTransform(rotation, position));
 
-	btScalar mass = size.x() * size.y() * size.z() / this->simulationParameters.bulkDensityFactor;
+	// Particles of all shapes weigh the same as they stand for the same bulk volume
+	btScalar mass = volume / (this->simulationParameters.bulkDensityFactor * getPackingCorrection(shape));
 
 	btVector3 fallInertia;
 
@@ -111,7 +169,7 @@ blendingsimulator::BlendingSimulatorDetailed<Parameters>::createParticle(btVecto
 	btRigidBody::btRigidBodyConstructionInfo fallRigidBodyCI(mass, particle->defaultMotionState, particle->collisionShape, fallInertia);
 
 	fallRigidBodyCI.m_friction = 0.5;
-	fallRigidBodyCI.m_linearDamping = 0.1;
+	fallRigidBodyCI.m_linearDamping = linearDamping;
 	fallRigidBodyCI.m_angularDamping = 0.1;
 	fallRigidBodyCI.m_restitution = 0;
 	fallRigidBodyCI.m_additionalDamping = true;
@@ -121,13 +179,22 @@ blendingsimulator::BlendingSimulatorDetailed<Parameters>::createParticle(btVecto
 	fallRigidBodyCI.m_angularSleepingThreshold = 0.5;
 	fallRigidBodyCI.m_linearSleepingThreshold = 0.5;
 
+	if (shape == ParticleShape::RollingSphere) {
+		fallRigidBodyCI.m_rollingFriction = 0.1;
+		fallRigidBodyCI.m_spinningFriction = 0.1;
+	}
+
 	particle->rigidBody = new btRigidBody(fallRigidBodyCI);
 	particle->rigidBody->setDeactivationTime(0.05f);
-	particle->rigidBody->setCcdMotionThreshold(0.5);
+	if (shape == ParticleShape::Box) {
+		// Sphere contacts are exact and do not need continuous collision detection at stacker speeds
+		particle->rigidBody->setCcdMotionThreshold(0.5);
+	}
 
 	allParticles.push_back(particle);
 	activeParticles.push_back(particle);
-	dynamicsWorld->addRigidBody(particle->rigidBody);
+	particle->partition = getPartitionIndex(position.x());
+	partitions[particle->partition].dynamicsWorld->addRigidBody(particle->rigidBody);
 
 	if (particle->frozen) {
 		freezeParticle(particle);
@@ -142,6 +209,8 @@ blendingsimulator::BlendingSimulatorDetailed<Parameters>::createParticle(btVecto
 template<typename Parameters>
 void blendingsimulator::BlendingSimulatorDetailed<Parameters>::freezeParticles()
 {
+	BLENDINGSIMULATOR_TRACE_SCOPE("freezeParticles");
+
 	for (auto it = activeParticles.begin(); it != activeParticles.end(); it++) {
 		ParticleDetailed<Parameters>* particle = *it;
 
@@ -171,26 +240,42 @@ void blendingsimulator::BlendingSimulatorDetailed<Parameters>::freezeParticle(Pa
 	// Update heap map
 	addParticleToHeapMap(origin.x(), origin.y(), origin.z());
 
+	this->logDeposit(
+		int32_t(std::lround(origin.x() / depositPositionScale)),
+		int32_t(std::lround(origin.y() / depositPositionScale)),
+		int32_t(std::lround(origin.z() / depositPositionScale)),
+		particle->parameters
+	);
+
+	// Let neighbor partitions collide with the particle
+	addGhosts(particle, trans);
+
 	// Looks nicer but totally ruins bulk density
 //	addParticleToHeapMapBilinear(origin.x(), origin.y(), origin.z());
 }
 
 template<typename Parameters>
 void blendingsimulator::BlendingSimulatorDetailed<Parameters>::addParticleToHeapMap(float x, float y, float z)
+{
+	// Set heap map height to maximum of current value and y
+	float& h = this->heapMap[getHeapMapIndex(x, z)];
+	if (y > h) {
+		h = y;
+	}
+}
+
+template<typename Parameters>
+unsigned int blendingsimulator::BlendingSimulatorDetailed<Parameters>::getHeapMapIndex(float x, float z)
 {
 	// Scale position to heap map resolution
 	x *= resolutionPerWorldSize;
 	z *= resolutionPerWorldSize;
 
 	// Calculate valid position indices
-	auto xi = std::max(0u, std::min((unsigned int)std::lround(x), this->heapSizeX - 1));
-	auto zi = std::max(0u, std::min((unsigned int)std::lround(z), this->heapSizeZ - 1));
+	auto xi = (unsigned int)std::max(0l, std::min(std::lround(x), long(this->heapSizeX - 1)));
+	auto zi = (unsigned int)std::max(0l, std::min(std::lround(z), long(this->heapSizeZ - 1)));
 
-	// Set heap map height to maximum of current value and y
-	float& h = this->heapMap[zi * this->heapSizeX + xi];
-	if (y > h) {
-		h = y;
-	}
+	return zi * this->heapSizeX + xi;
 }
 
 void setBilinear(float* heapMap, int sizeX, int sizeZ, float x, float z, int xi, int zi, float vMin, float vMax)
@@ -224,6 +309,8 @@ void blendingsimulator::BlendingSimulatorDetailed<Parameters>::addParticleToHeap
 template<typename Parameters>
 void blendingsimulator::BlendingSimulatorDetailed<Parameters>::optimizeFrozenParticles()
 {
+	BLENDINGSIMULATOR_TRACE_SCOPE("optimizeFrozenParticles");
+
 	for (auto it = allParticles.begin(); it != allParticles.end(); it++) {
 		ParticleDetailed<Parameters>* particle = *it;
 
@@ -237,8 +324,7 @@ void blendingsimulator::BlendingSimulatorDetailed<Parameters>::optimizeFrozenPar
 
 			if (x >= 0 & x < this->heapSizeX && z > 0 && z < this->heapSizeZ) {
 				if (origin.getY() < this->heapMap[z * this->heapSizeX + x] - 4.0 * particleSize) {
-					dynamicsWorld->removeRigidBody(particle->rigidBody);
-					particle->inSimulation = false;
+					removeFromSimulation(particle);
 				}
 			}
 		}
@@ -248,9 +334,11 @@ void blendingsimulator::BlendingSimulatorDetailed<Parameters>::optimizeFrozenPar
 template<typename Parameters>
 void blendingsimulator::BlendingSimulatorDetailed<Parameters>::finishStacking()
 {
-	while (activeParticlesAvailable.load()) {
+	while (activeParticlesAvailable.load() || !ballisticParticles.empty()) {
 		step();
 	}
+
+	this->flushDepositLog();
 }
 
 template<typename Parameters>
@@ -260,8 +348,11 @@ bool blendingsimulator::BlendingSimulatorDetailed<Parameters>::reclaimingFinishe
 }
 
 template<typename Parameters>
-Parameters blendingsimulator::BlendingSimulatorDetailed<Parameters>::reclaim(float position)
+void blendingsimulator::BlendingSimulatorDetailed<Parameters>::reclaimInto(float position, Parameters& out)
 {
+	BLENDINGSIMULATOR_TRACE_SCOPE("reclaim");
+	BLENDINGSIMULATOR_ALLOCATION_PHASE(Reclaim);
+
 	double tanReclaimAngle;
 	if (std::abs(90.0f - this->simulationParameters.reclaimAngle) < 0.01) {
 		tanReclaimAngle = 1e100;
@@ -272,7 +363,7 @@ Parameters blendingsimulator::BlendingSimulatorDetailed<Parameters>::reclaim(flo
 	double radius = 0.25 * std::min(this->simulationParameters.heapWorldSizeX, this->simulationParameters.heapWorldSizeZ);
 	double circumference = 2.0 * this->pi * radius;
 
-	Parameters p;
+	out.clear();
 	for (auto it = allParticles.begin(); it != allParticles.end();) {
 		ParticleDetailed<Parameters>* particle = *it;
 
@@ -314,16 +405,14 @@ Parameters blendingsimulator::BlendingSimulatorDetailed<Parameters>::reclaim(flo
 		}
 
 		if (comparePosition < position) {
-			p.push(particle->parameters);
-			dynamicsWorld->removeRigidBody(particle->rigidBody);
+			out.push(particle->parameters);
+			removeFromSimulation(particle);
 			delete particle;
 			it = allParticles.erase(it);
 		} else {
 			it++;
 		}
 	}
-
-	return p;
 }
 
 template<typename Parameters>
@@ -334,31 +423,57 @@ void blendingsimulator::BlendingSimulatorDetailed<Parameters>::stackSingle(float
 		step();
 	}
 
-	// TODO OMG this leaks particle size between two executions of the simulator
-	static const float sizeVariation = particleSize * 0.05f;
-	static const float positionVariation = 0.5f * stackerBeltWidth;
-	static const float miscVariation = 0.005f; // 1 +/- variation for speed, height, and angle
+	const float sizeVariation = shapeSize * 0.05f;
+	const float positionVariation = 0.5f * stackerBeltWidth;
+	const float miscVariation = 0.005f; // 1 +/- variation for speed, height, and angle
 
-	static std::random_device rd;
-	static std::default_random_engine generator(rd());
-	static std::uniform_real_distribution<float> sizeDist(-sizeVariation, sizeVariation);
-	static std::uniform_real_distribution<float> posDist(-positionVariation, positionVariation);
-	static std::uniform_real_distribution<float> minVarDist(1 - miscVariation, 1 + miscVariation);
-	static std::uniform_real_distribution<float> angle(0.0f, 2.0f * this->pi);
+	// Draws are sequenced explicitly as the evaluation order of function arguments is unspecified
+	RandomStream random = this->nextParticleRandom();
 
-	createParticle(
+	btVector3 size;
+	if (this->simulationParameters.particleShape == ParticleShape::Box) {
+		const float sizeX = shapeSize + random.uniform(-sizeVariation, sizeVariation);
+		const float sizeY = shapeSize + random.uniform(-sizeVariation, sizeVariation);
+		const float sizeZ = shapeSize + random.uniform(-sizeVariation, sizeVariation);
+		size = btVector3(sizeX, sizeY, sizeZ);
+	} else {
+		const float diameter = shapeSize + random.uniform(-sizeVariation, sizeVariation);
+		size = btVector3(diameter, diameter, diameter);
+	}
+
+	const float positionOffset = random.uniform(-positionVariation, positionVariation);
+	const float heightFactor = random.uniform(1 - miscVariation, 1 + miscVariation);
+	const float angleFactor = random.uniform(1 - miscVariation, 1 + miscVariation);
+	const float speedFactor = random.uniform(1 - miscVariation, 1 + miscVariation);
+	const float rotation = random.uniform(0.0f, 2.0f * this->pi);
+
+	BallisticParticle particle{
 		btVector3(
-			x + posDist(generator),
-			this->simulationParameters.dropHeight * minVarDist(generator),
+			x + positionOffset,
+			this->simulationParameters.dropHeight * heightFactor,
 			z - 5.0f
 		), // Position
+		btVector3(0, 0, 1).rotate(btVector3(-1, 0, 0), stackerDropOffAngle * angleFactor) * stackerBeltSpeed * speedFactor, // Angle and speed
+		btQuaternion(btVector3(0, 0, 1), rotation), // Orientation
+		size, // Size
 		parameters, // Parameters
-		false, // Frozen
-		btQuaternion(btVector3(0, 0, 1), angle(generator)), // Orientation
-		btVector3(0, 0, 1).rotate(btVector3(-1, 0, 0), stackerDropOffAngle * minVarDist(generator)) * stackerBeltSpeed *
-			minVarDist(generator), // Angle and speed
-		btVector3(particleSize + sizeDist(generator), particleSize + sizeDist(generator), particleSize + sizeDist(generator)) // Size
-	);
+		simulationTickCount, // Creation tick count
+		nullptr // Output particle
+	};
+
+	if (!this->simulationParameters.ballisticPreIntegration) {
+		createParticle(particle.position, particle.parameters, false, particle.rotation, particle.velocity, particle.size);
+	} else {
+		// Falling particles take the same path with and without visualization, they are only mirrored for the output
+		if (this->simulationParameters.visualize) {
+			BLENDINGSIMULATOR_ALLOCATION_PHASE(Output);
+			particle.outputParticle = new Particle<Parameters>();
+			particle.outputParticle->parameters = particle.parameters;
+			particle.outputParticle->size = Vector3(particle.size.x(), particle.size.y(), particle.size.z());
+			particle.outputParticle->frozen = false;
+		}
+		ballisticParticles.push_back(particle);
+	}
 
 	nextParticleTickCount = simulationTickCount + simulationTicksPerParticle;
 }
@@ -371,13 +486,17 @@ void blendingsimulator::BlendingSimulatorDetailed<Parameters>::step()
 		return;
 	}
 
+	BLENDINGSIMULATOR_TRACE_SCOPE("step");
+	BLENDINGSIMULATOR_ALLOCATION_PHASE(Fall);
 	std::lock_guard<std::mutex> lock(simulationMutex);
 
+	advanceBallisticParticles();
+
 	const float timeStep = float(simulationIntervalMs) / 1000.0f;
-	dynamicsWorld->stepSimulation(timeStep, simulationIntervalSubSteps, timeStep / float(simulationIntervalSubSteps));
+	stepPartitions(timeStep);
+	migrateParticles();
 	doOutputParticles();
 	freezeParticles();
-	static int optimizeFrozenParticlesCounter = 0;
 	optimizeFrozenParticlesCounter = (optimizeFrozenParticlesCounter + 1) % 100;
 	if (optimizeFrozenParticlesCounter == 0) {
 		optimizeFrozenParticles();
@@ -385,6 +504,306 @@ void blendingsimulator::BlendingSimulatorDetailed<Parameters>::step()
 	simulationTickCount += simulationIntervalMs;
 }
 
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorDetailed<Parameters>::stepPartition(PhysicsPartition& partition, float timeStep)
+{
+	BLENDINGSIMULATOR_TRACE_SCOPE("stepSimulation");
+	partition.dynamicsWorld->stepSimulation(timeStep, simulationIntervalSubSteps, timeStep / float(simulationIntervalSubSteps));
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorDetailed<Parameters>::stepPartitions(float timeStep)
+{
+	if (partitions.size() == 1) {
+		stepPartition(partitions.front(), timeStep);
+		return;
+	}
+
+	// Worlds share no state apart from read-only collision shapes and can therefore be stepped concurrently
+	{
+		std::lock_guard<std::mutex> lock(partitionWorkersMutex);
+		partitionTimeStep = timeStep;
+		pendingPartitionSteps = static_cast<unsigned int>(partitionWorkers.size());
+		partitionStepCount++;
+	}
+	partitionStepStarted.notify_all();
+
+	stepPartition(partitions.front(), timeStep);
+
+	std::unique_lock<std::mutex> lock(partitionWorkersMutex);
+	partitionStepFinished.wait(lock, [this]() { return pendingPartitionSteps == 0; });
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorDetailed<Parameters>::runPartitionWorker(unsigned int partitionIndex)
+{
+	unsigned long long steppedCount = 0;
+
+	while (true) {
+		float timeStep;
+		{
+			std::unique_lock<std::mutex> lock(partitionWorkersMutex);
+			partitionStepStarted.wait(lock, [this, steppedCount]() { return partitionWorkersStopping || partitionStepCount != steppedCount; });
+			if (partitionWorkersStopping) {
+				return;
+			}
+			steppedCount = partitionStepCount;
+			timeStep = partitionTimeStep;
+		}
+
+		stepPartition(partitions[partitionIndex], timeStep);
+
+		{
+			std::lock_guard<std::mutex> lock(partitionWorkersMutex);
+			pendingPartitionSteps--;
+			if (pendingPartitionSteps == 0) {
+				partitionStepFinished.notify_one();
+			}
+		}
+	}
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorDetailed<Parameters>::stopPartitionWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(partitionWorkersMutex);
+		partitionWorkersStopping = true;
+	}
+	partitionStepStarted.notify_all();
+
+	for (std::thread& worker : partitionWorkers) {
+		worker.join();
+	}
+	partitionWorkers.clear();
+}
+
+// Move bodies which left the strip of their partition into the neighboring world and let proxies follow the others
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorDetailed<Parameters>::migrateParticles()
+{
+	BLENDINGSIMULATOR_TRACE_SCOPE("migrateParticles");
+
+	if (partitions.size() == 1) {
+		return;
+	}
+
+	for (ParticleDetailed<Parameters>* particle : activeParticles) {
+		if (particle->frozen || !particle->inSimulation) {
+			continue;
+		}
+
+		btTransform trans;
+		particle->defaultMotionState->getWorldTransform(trans);
+		const unsigned int partition = getPartitionIndex(trans.getOrigin().x());
+
+		if (partition != particle->partition) {
+			// Velocities are kept by the body while it is not part of any world
+			partitions[particle->partition].dynamicsWorld->removeRigidBody(particle->rigidBody);
+			partitions[partition].dynamicsWorld->addRigidBody(particle->rigidBody);
+			particle->partition = partition;
+		}
+
+		updateGhosts(particle, trans);
+	}
+}
+
+template<typename Parameters>
+unsigned int blendingsimulator::BlendingSimulatorDetailed<Parameters>::getPartitionIndex(float x)
+{
+	const int index = int(std::floor(x / partitionWidth));
+	return (unsigned int)std::max(0, std::min(index, int(partitions.size()) - 1));
+}
+
+template<typename Parameters>
+bool blendingsimulator::BlendingSimulatorDetailed<Parameters>::isInGhostZone(unsigned int partitionIndex, float x) const
+{
+	const float minX = float(partitionIndex) * partitionWidth - ghostZoneWidth;
+	const float maxX = float(partitionIndex + 1) * partitionWidth + ghostZoneWidth;
+	return x >= minX && x <= maxX;
+}
+
+// Active particles close to a boundary are mirrored by kinematic proxies moved along with them every step
+// Proxies act with infinite mass, they push bodies of the neighbor partition but contact forces are not fed back to the particle
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorDetailed<Parameters>::updateGhosts(ParticleDetailed<Parameters>* particle, const btTransform& trans)
+{
+	const float x = trans.getOrigin().x();
+
+	// Drop proxies in the own partition after migration and in partitions the particle moved away from
+	for (auto it = particle->ghosts.begin(); it != particle->ghosts.end();) {
+		if (it->first == particle->partition || !isInGhostZone(it->first, x)) {
+			partitions[it->first].dynamicsWorld->removeRigidBody(it->second);
+			delete it->second;
+			it = particle->ghosts.erase(it);
+		} else {
+			// Bullet derives the proxy velocity from the previous transform
+			it->second->setWorldTransform(trans);
+			it++;
+		}
+	}
+
+	for (unsigned int neighbor : {particle->partition - 1, particle->partition + 1}) {
+		if (neighbor >= partitions.size() || !isInGhostZone(neighbor, x)) {
+			// Also catches the wrap around of the first partition
+			continue;
+		}
+
+		const bool exists = std::any_of(particle->ghosts.begin(), particle->ghosts.end(), [neighbor](const std::pair<unsigned int, btRigidBody*>& ghost) {
+			return ghost.first == neighbor;
+		});
+		if (exists) {
+			continue;
+		}
+
+		btRigidBody::btRigidBodyConstructionInfo proxyRigidBodyCI(0, nullptr, particle->collisionShape, btVector3(0, 0, 0));
+		proxyRigidBodyCI.m_startWorldTransform = trans;
+		proxyRigidBodyCI.m_friction = 0.5;
+		proxyRigidBodyCI.m_restitution = 0;
+		auto proxy = new btRigidBody(proxyRigidBodyCI);
+		proxy->setCollisionFlags(proxy->getCollisionFlags() | btCollisionObject::CF_KINEMATIC_OBJECT);
+		proxy->setActivationState(DISABLE_DEACTIVATION);
+
+		partitions[neighbor].dynamicsWorld->addRigidBody(proxy);
+		particle->ghosts.emplace_back(neighbor, proxy);
+	}
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorDetailed<Parameters>::removeGhosts(ParticleDetailed<Parameters>* particle)
+{
+	for (auto& ghost : particle->ghosts) {
+		partitions[ghost.first].dynamicsWorld->removeRigidBody(ghost.second);
+		delete ghost.second;
+	}
+	particle->ghosts.clear();
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorDetailed<Parameters>::addGhosts(ParticleDetailed<Parameters>* particle, const btTransform& trans)
+{
+	if (partitions.size() == 1 || !particle->inSimulation) {
+		return;
+	}
+
+	// Proxies of the moving particle are replaced by static copies
+	removeGhosts(particle);
+
+	const float x = trans.getOrigin().x();
+	for (unsigned int neighbor : {particle->partition - 1, particle->partition + 1}) {
+		if (neighbor >= partitions.size() || !isInGhostZone(neighbor, x)) {
+			// Also catches the wrap around of the first partition
+			continue;
+		}
+
+		// Ghosts are static and never move, so they share the collision shape and need no motion state
+		btRigidBody::btRigidBodyConstructionInfo ghostRigidBodyCI(0, nullptr, particle->collisionShape, btVector3(0, 0, 0));
+		ghostRigidBodyCI.m_startWorldTransform = trans;
+		ghostRigidBodyCI.m_friction = 0.5;
+		ghostRigidBodyCI.m_restitution = 0;
+		auto ghost = new btRigidBody(ghostRigidBodyCI);
+
+		partitions[neighbor].dynamicsWorld->addRigidBody(ghost);
+		particle->ghosts.emplace_back(neighbor, ghost);
+	}
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorDetailed<Parameters>::removeFromSimulation(ParticleDetailed<Parameters>* particle)
+{
+	if (!particle->inSimulation) {
+		return;
+	}
+
+	partitions[particle->partition].dynamicsWorld->removeRigidBody(particle->rigidBody);
+	removeGhosts(particle);
+	particle->inSimulation = false;
+}
+
+// Move falling particles without involving the physics engine until they are about to hit the heap
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorDetailed<Parameters>::advanceBallisticParticles()
+{
+	BLENDINGSIMULATOR_TRACE_SCOPE("advanceBallisticParticles");
+
+	if (ballisticParticles.empty()) {
+		return;
+	}
+
+	updateActiveSurface();
+
+	// Same integration scheme as btRigidBody: gravity, damping, then position
+	const btScalar subStep = btScalar(simulationIntervalMs) / btScalar(1000.0 * simulationIntervalSubSteps);
+	const btVector3 gravityStep = btVector3(0, -9.80665f, 0) * subStep;
+	const btScalar dampingFactor = btPow(btScalar(1) - linearDamping, subStep);
+
+	size_t keptCount = 0;
+	for (size_t i = 0; i < ballisticParticles.size(); i++) {
+		BallisticParticle& particle = ballisticParticles[i];
+
+		btVector3 nextPosition = particle.position;
+		btVector3 nextVelocity = particle.velocity;
+		for (int s = 0; s < simulationIntervalSubSteps; s++) {
+			nextVelocity += gravityStep;
+			nextVelocity *= dampingFactor;
+			nextPosition += nextVelocity * subStep;
+		}
+
+		// Hand over to physics if the particle could touch anything during the upcoming step
+		const float bottom = nextPosition.y() - 0.5f * particle.size.length();
+		const float surface = std::max(getSurfaceHeight(particle.position), getSurfaceHeight(nextPosition));
+		if (bottom <= surface + ballisticMarginFactor * particleSize) {
+			ParticleDetailed<Parameters>* particleDetailed = createParticle(particle.position, particle.parameters, false, particle.rotation,
+				particle.velocity, particle.size);
+			particleDetailed->creationTickCount = particle.creationTickCount;
+			particleDetailed->outputParticle = particle.outputParticle;
+		} else {
+			particle.position = nextPosition;
+			particle.velocity = nextVelocity;
+			if (keptCount != i) {
+				ballisticParticles[keptCount] = particle;
+			}
+			keptCount++;
+		}
+	}
+
+	ballisticParticles.erase(ballisticParticles.begin() + keptCount, ballisticParticles.end());
+}
+
+// Track the top of particles which are still moving and therefore not part of the heap map
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorDetailed<Parameters>::updateActiveSurface()
+{
+	for (unsigned int cell : activeSurfaceCells) {
+		activeSurface[cell] = 0.0f;
+	}
+	activeSurfaceCells.clear();
+
+	for (ParticleDetailed<Parameters>* particle : activeParticles) {
+		if (particle->frozen) {
+			continue;
+		}
+
+		btTransform trans;
+		particle->defaultMotionState->getWorldTransform(trans);
+		const btVector3& origin = trans.getOrigin();
+
+		const unsigned int cell = getHeapMapIndex(origin.x(), origin.z());
+		const float top = origin.y() + 0.5f * particle->size.length();
+		if (activeSurface[cell] == 0.0f) {
+			activeSurfaceCells.push_back(cell);
+		}
+		activeSurface[cell] = std::max(activeSurface[cell], top);
+	}
+}
+
+template<typename Parameters>
+float blendingsimulator::BlendingSimulatorDetailed<Parameters>::getSurfaceHeight(const btVector3& position)
+{
+	const unsigned int cell = getHeapMapIndex(position.x(), position.z());
+	return std::max(this->heapMap[cell], activeSurface[cell]);
+}
+
 std::tuple<double, double, double, double> toTuple(btQuaternion q)
 {
 	return std::make_tuple(q.w(), q.x(), q.y(), q.z());
@@ -395,36 +814,65 @@ std::tuple<double, double, double> toTuple(btVector3 v)
 	return std::make_tuple(v.x(), v.y(), v.z());
 }
 
-// Output particle details to graphics interface
+// Output particle details to graphics interface and drop frozen particles from the active list
 template<typename Parameters>
 void blendingsimulator::BlendingSimulatorDetailed<Parameters>::doOutputParticles()
 {
-	std::lock_guard<std::mutex> lock(this->outputParticlesMutex);
+	BLENDINGSIMULATOR_TRACE_SCOPE("doOutputParticles");
+	BLENDINGSIMULATOR_ALLOCATION_PHASE(Output);
 
-	for (auto it = activeParticles.begin(); it != activeParticles.end();) {
-		ParticleDetailed<Parameters>* particle = *it;
+	// Nobody reads output particles without visualization, so only the active list is maintained
+	const bool visualize = this->simulationParameters.visualize;
 
-		if (!particle->outputParticle) {
-			particle->outputParticle = new Particle<Parameters>();
+	std::unique_lock<std::mutex> lock(this->outputParticlesMutex, std::defer_lock);
+	if (visualize) {
+		lock.lock();
+	}
 
-			this->activeOutputParticles.push_back(particle->outputParticle);
-		}
+	// activeOutputParticles lists the output of active particles in order followed by the ballistic ones
+	if (visualize) {
+		this->activeOutputParticles.clear();
+	}
 
-		btTransform trans;
-		particle->defaultMotionState->getWorldTransform(trans);
+	size_t keptCount = 0;
+	for (size_t i = 0; i < activeParticles.size(); i++) {
+		ParticleDetailed<Parameters>* particle = activeParticles[i];
+
+		if (visualize) {
+			if (!particle->outputParticle) {
+				// Parameters and size never change so they are copied only once
+				particle->outputParticle = new Particle<Parameters>();
+				particle->outputParticle->parameters = particle->parameters;
+				particle->outputParticle->size = Vector3(toTuple(particle->size));
+			}
 
-		particle->outputParticle->parameters = particle->parameters;
-		particle->outputParticle->frozen = particle->frozen;
-		particle->outputParticle->position = Vector3(toTuple(trans.getOrigin()));
-		particle->outputParticle->size = Vector3(toTuple(particle->size));
-		particle->outputParticle->orientation = Quaternion(toTuple(trans.getRotation()));
+			btTransform trans;
+			particle->defaultMotionState->getWorldTransform(trans);
+
+			particle->outputParticle->frozen = particle->frozen;
+			particle->outputParticle->position = Vector3(toTuple(trans.getOrigin()));
+			particle->outputParticle->orientation = Quaternion(toTuple(trans.getRotation()));
+		}
 
 		if (particle->frozen) {
-			it = activeParticles.erase(it);
-			this->activeOutputParticles.erase(std::find(this->activeOutputParticles.begin(), this->activeOutputParticles.end(), particle->outputParticle));
-			this->inactiveOutputParticles.push_back(particle->outputParticle);
+			if (visualize) {
+				this->inactiveOutputParticles.push_back(particle->outputParticle);
+			}
 		} else {
-			it++;
+			activeParticles[keptCount] = particle;
+			if (visualize) {
+				this->activeOutputParticles.push_back(particle->outputParticle);
+			}
+			keptCount++;
+		}
+	}
+
+	activeParticles.resize(keptCount);
+	if (visualize) {
+		for (const BallisticParticle& particle : ballisticParticles) {
+			particle.outputParticle->position = Vector3(toTuple(particle.position));
+			particle.outputParticle->orientation = Quaternion(toTuple(particle.rotation));
+			this->activeOutputParticles.push_back(particle.outputParticle);
 		}
 	}
 
@@ -1,6 +1,9 @@
 #ifndef ParticleDetailedH
 #define ParticleDetailedH
 
+// STL
+#include <vector>
+
 // Bullet
 #include <LinearMath/btVector3.h>
 #include <LinearMath/btQuaternion.h>
@@ -24,12 +27,17 @@ struct ParticleDetailed
 	bool frozen;
 	bool inSimulation;
 	unsigned long long creationTickCount;
+	unsigned int partition;
 
 	Parameters parameters;
 	btCollisionShape* collisionShape;
 	btRigidBody* rigidBody;
 	btDefaultMotionState* defaultMotionState;
 
+	// Copies in neighbor partitions while close to their boundary, paired with the index of the partition they are placed in
+	// Kinematic proxies follow active particles every step, frozen particles are mirrored by static copies
+	std::vector<std::pair<unsigned int, btRigidBody*>> ghosts;
+
 	Particle<Parameters>* outputParticle;
 
 	ParticleDetailed();
@@ -6,6 +6,7 @@ blendingsimulator::ParticleDetailed<Parameters>::ParticleDetailed()
 	: frozen(false)
 	, inSimulation(true)
 	, creationTickCount(0)
+	, partition(0)
 	, collisionShape(nullptr)
 	, rigidBody(nullptr)
 	, defaultMotionState(nullptr)
@@ -16,6 +17,10 @@ blendingsimulator::ParticleDetailed<Parameters>::ParticleDetailed()
 template<typename Parameters>
 blendingsimulator::ParticleDetailed<Parameters>::~ParticleDetailed()
 {
+	for (auto& ghost : ghosts) {
+		delete ghost.second;
+	}
+
 	if (collisionShape) {
 		delete collisionShape;
 	}
@@ -1,5 +1,9 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #include "BlendingSimulator/BlendingSimulatorDetailed.h"
 #include "BlendingSimulator/ParticleParameters.h"
 
@@ -126,3 +130,263 @@ TEST(BlendingSimulatorDetailed, test_stack_reclaim)
 		EXPECT_TRUE(simulator.reclaimingFinished());
 	}
 }
+
+TEST(BlendingSimulatorDetailed, test_output_particles)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 3.0f;
+	simulationParameters.heapWorldSizeZ = 3.0f;
+	simulationParameters.reclaimAngle = 45.0;
+	simulationParameters.bulkDensityFactor = 1.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.dropHeight = 10.0f;
+	simulationParameters.seed = 7;
+
+	std::vector<float> heapMaps[2];
+	for (bool visualize : {false, true}) {
+		simulationParameters.visualize = visualize;
+		bs::BlendingSimulatorDetailed<bs::AveragedParameters> simulator(simulationParameters);
+
+		double volume = 5.0;
+		bs::AveragedParameters p(volume, {1.0});
+
+		simulator.stack(1.0f, 1.0f, p);
+		simulator.finishStacking();
+
+		std::pair<unsigned int, unsigned int> heapMapSize = simulator.getHeapMapSize();
+		float* heapMap = simulator.getHeapMap();
+		heapMaps[visualize].assign(heapMap, heapMap + heapMapSize.first * heapMapSize.second);
+
+		std::lock_guard<std::mutex> lock(simulator.outputParticlesMutex);
+		EXPECT_TRUE(simulator.activeOutputParticles.empty());
+		EXPECT_EQ(simulator.inactiveOutputParticles.size(), visualize ? 5 : 0);
+	}
+
+	// Output is only mirrored, the simulated heap is the same
+	EXPECT_EQ(heapMaps[0], heapMaps[1]);
+}
+
+TEST(BlendingSimulatorDetailed, test_ballistic_pre_integration)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 6.0f;
+	simulationParameters.heapWorldSizeZ = 6.0f;
+	simulationParameters.reclaimAngle = 45.0;
+	simulationParameters.bulkDensityFactor = 1.0f;
+	simulationParameters.particlesPerCubicMeter = 8.0f;
+	simulationParameters.dropHeight = 5.0f;
+	simulationParameters.seed = 5;
+
+	auto stackPile = [&](bool ballisticPreIntegration, unsigned int& footprint) {
+		simulationParameters.ballisticPreIntegration = ballisticPreIntegration;
+		bs::BlendingSimulatorDetailed<bs::AveragedParameters> simulator(simulationParameters);
+		simulator.stack(3.0f, 3.0f, {10.0, {1.0}});
+		simulator.finishStacking();
+
+		std::pair<unsigned int, unsigned int> heapMapSize = simulator.getHeapMapSize();
+		float* heapMap = simulator.getHeapMap();
+		float maxHeight = 0.0f;
+		footprint = 0;
+		for (unsigned int i = 0; i < heapMapSize.first * heapMapSize.second; i++) {
+			maxHeight = std::max(maxHeight, heapMap[i]);
+			if (heapMap[i] > 0.0f) {
+				footprint++;
+			}
+		}
+		return maxHeight;
+	};
+
+	// Falling outside of the physics engine forms the same pile as falling inside of it
+	unsigned int footprint = 0;
+	const float height = stackPile(false, footprint);
+	unsigned int preIntegratedFootprint = 0;
+	const float preIntegratedHeight = stackPile(true, preIntegratedFootprint);
+	EXPECT_GT(height, 0.0f);
+	EXPECT_NEAR(preIntegratedHeight, height, 0.15f * height);
+	EXPECT_NEAR(double(preIntegratedFootprint), double(footprint), 0.15 * footprint);
+}
+
+TEST(BlendingSimulatorDetailed, test_stack_heap_height)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 3.0f;
+	simulationParameters.heapWorldSizeZ = 3.0f;
+	simulationParameters.reclaimAngle = 45.0;
+	simulationParameters.bulkDensityFactor = 1.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.dropHeight = 10.0f;
+
+	{
+		bs::BlendingSimulatorDetailed<bs::AveragedParameters> simulator(simulationParameters);
+
+		double volume = 5.0;
+		bs::AveragedParameters p(volume, {1.0});
+
+		simulator.stack(1.0f, 1.0f, p);
+		simulator.finishStacking();
+
+		std::pair<unsigned int, unsigned int> heapMapSize = simulator.getHeapMapSize();
+		float* heapMap = simulator.getHeapMap();
+		ASSERT_NE(heapMap, nullptr);
+		float maxHeight = 0.0f;
+		for (unsigned int i = 0; i < heapMapSize.first * heapMapSize.second; i++) {
+			maxHeight = std::max(maxHeight, heapMap[i]);
+		}
+
+		// All particles have landed instead of being frozen mid-air
+		EXPECT_GT(maxHeight, 0.0f);
+		EXPECT_LT(maxHeight, 0.5f * simulationParameters.dropHeight);
+	}
+}
+
+TEST(BlendingSimulatorDetailed, test_stack_reclaim_shapes)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 3.0f;
+	simulationParameters.heapWorldSizeZ = 3.0f;
+	simulationParameters.reclaimAngle = 45.0;
+	simulationParameters.bulkDensityFactor = 1.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.dropHeight = 10.0f;
+
+	for (bs::ParticleShape shape : {bs::ParticleShape::Sphere, bs::ParticleShape::RollingSphere}) {
+		simulationParameters.particleShape = shape;
+		bs::BlendingSimulatorDetailed<bs::AveragedParameters> simulator(simulationParameters);
+
+		double volume = 5.0;
+		bs::AveragedParameters p(volume, {1.0});
+
+		simulator.stack(1.0f, 1.0f, p);
+		simulator.finishStacking();
+
+		EXPECT_FALSE(simulator.reclaimingFinished());
+		bs::AveragedParameters pOut = simulator.reclaim(100);
+		EXPECT_NEAR(pOut.getVolume(), volume, 1e-10);
+
+		EXPECT_TRUE(simulator.reclaimingFinished());
+	}
+}
+
+TEST(BlendingSimulatorDetailed, test_heap_volume_shapes)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 6.0f;
+	simulationParameters.heapWorldSizeZ = 6.0f;
+	simulationParameters.reclaimAngle = 45.0;
+	simulationParameters.bulkDensityFactor = 1.0f;
+	simulationParameters.particlesPerCubicMeter = 8.0f;
+	simulationParameters.dropHeight = 5.0f;
+	simulationParameters.seed = 5;
+
+	// Integrates the settled heap map
+	auto stackHeapVolume = [&](bs::ParticleShape shape) {
+		simulationParameters.particleShape = shape;
+		bs::BlendingSimulatorDetailed<bs::AveragedParameters> simulator(simulationParameters);
+		simulator.stack(3.0f, 3.0f, {10.0, {1.0}});
+		simulator.finishStacking();
+
+		const std::pair<unsigned int, unsigned int> heapMapSize = simulator.getHeapMapSize();
+		const std::pair<float, float> heapWorldSize = simulator.getHeapWorldSize();
+		const float* heapMap = simulator.getHeapMap();
+		const double cellArea = heapWorldSize.first / heapMapSize.first * heapWorldSize.second / heapMapSize.second;
+		double volume = 0.0;
+		for (unsigned int i = 0; i < heapMapSize.first * heapMapSize.second; i++) {
+			volume += std::max(0.0f, heapMap[i]) * cellArea;
+		}
+		return volume;
+	};
+
+	// Spheres pack looser than boxes, their size correction keeps the bulk volume of the heap
+	const double boxVolume = stackHeapVolume(bs::ParticleShape::Box);
+	EXPECT_GT(boxVolume, 0.0);
+	for (bs::ParticleShape shape : {bs::ParticleShape::Sphere, bs::ParticleShape::RollingSphere}) {
+		EXPECT_NEAR(stackHeapVolume(shape), boxVolume, 0.2 * boxVolume) << "shape " << int(shape);
+	}
+}
+
+TEST(BlendingSimulatorDetailed, test_stack_reclaim_partitions)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 6.0f;
+	simulationParameters.heapWorldSizeZ = 3.0f;
+	simulationParameters.reclaimAngle = 45.0;
+	simulationParameters.bulkDensityFactor = 1.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.dropHeight = 10.0f;
+	simulationParameters.physicsPartitions = 3;
+
+	{
+		bs::BlendingSimulatorDetailed<bs::AveragedParameters> simulator(simulationParameters);
+
+		double volume = 3.0;
+		bs::AveragedParameters p(volume, {1.0});
+
+		// Stack onto partition boundaries so that particles migrate and ghosts get created
+		simulator.stack(2.0f, 1.0f, p);
+		simulator.stack(4.0f, 1.0f, p);
+		simulator.finishStacking();
+
+		EXPECT_FALSE(simulator.reclaimingFinished());
+		bs::AveragedParameters pOut = simulator.reclaim(100);
+		EXPECT_NEAR(pOut.getVolume(), 2.0 * volume, 1e-10);
+
+		EXPECT_TRUE(simulator.reclaimingFinished());
+	}
+}
+
+TEST(BlendingSimulatorDetailed, test_pile_straddling_partitions)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 6.0f;
+	simulationParameters.heapWorldSizeZ = 6.0f;
+	simulationParameters.reclaimAngle = 45.0;
+	simulationParameters.bulkDensityFactor = 1.0f;
+	simulationParameters.particlesPerCubicMeter = 8.0f;
+	simulationParameters.dropHeight = 5.0f;
+	simulationParameters.seed = 3;
+
+	struct Pile
+	{
+		float height;
+		double angle;
+		double reclaimedVolume;
+	};
+
+	auto stackPile = [&](unsigned int physicsPartitions) {
+		simulationParameters.physicsPartitions = physicsPartitions;
+		bs::BlendingSimulatorDetailed<bs::AveragedParameters> simulator(simulationParameters);
+
+		// The boundary of two partitions runs through the center of the pile
+		simulator.stack(3.0f, 3.0f, {20.0, {1.0}});
+		simulator.finishStacking();
+
+		// Angle of repose from the height and the radius of the covered area
+		std::pair<unsigned int, unsigned int> heapMapSize = simulator.getHeapMapSize();
+		std::pair<float, float> heapWorldSize = simulator.getHeapWorldSize();
+		float* heapMap = simulator.getHeapMap();
+		const double cellArea = heapWorldSize.first / heapMapSize.first * heapWorldSize.second / heapMapSize.second;
+		Pile pile{0.0f, 0.0, 0.0};
+		double coveredArea = 0.0;
+		for (unsigned int i = 0; i < heapMapSize.first * heapMapSize.second; i++) {
+			pile.height = std::max(pile.height, heapMap[i]);
+			if (heapMap[i] > 0.0f) {
+				coveredArea += cellArea;
+			}
+		}
+		pile.angle = std::atan(pile.height / std::sqrt(coveredArea / 3.141592653589793238463)) * 180.0 / 3.141592653589793238463;
+
+		pile.reclaimedVolume = simulator.reclaim(100).getVolume();
+		EXPECT_TRUE(simulator.reclaimingFinished());
+		return pile;
+	};
+
+	const Pile single = stackPile(1);
+	EXPECT_NEAR(single.reclaimedVolume, 20.0, 1e-10);
+	EXPECT_GT(single.height, 0.0f);
+
+	// Moving particles collide across the boundary through their proxies instead of sinking into each other
+	const Pile partitioned = stackPile(2);
+	EXPECT_NEAR(partitioned.reclaimedVolume, 20.0, 1e-10);
+	EXPECT_NEAR(partitioned.height, single.height, 0.1f * single.height);
+	EXPECT_NEAR(partitioned.angle, single.angle, 3.0);
+}
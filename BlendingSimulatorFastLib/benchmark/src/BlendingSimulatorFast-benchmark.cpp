@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "BlendingSimulator/BlendingSimulatorFast.h"
+#include "BlendingSimulator/ParticleParameters.h"
+
+namespace bs = blendingsimulator;
+
+// Stacks a growing cone onto a single spot and reports the descent cost of each batch against the pile height
+void runCone(bool acceleratedDescent, float eightLikelihood, unsigned int particles)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 300.0f;
+	simulationParameters.heapWorldSizeZ = 300.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.eightLikelihood = eightLikelihood;
+	simulationParameters.acceleratedDescent = acceleratedDescent;
+	simulationParameters.seed = 1;
+
+	bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+
+	// Batches double in size so that the pile height grows steadily from one line to the next
+	unsigned int stacked = 0;
+	unsigned int batchSize = std::min(particles, 25000u);
+	while (stacked < particles) {
+		const unsigned int batch = std::min(batchSize, particles - stacked);
+		const uint64_t stepsBefore = simulator.getDescentStepCount();
+		const auto start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < batch; i++) {
+			simulator.stack(150.0f, 150.0f, bs::AveragedParameters(1.0, {1.0}));
+		}
+		const auto end = std::chrono::steady_clock::now();
+		stacked += batch;
+		batchSize = stacked;
+
+		simulator.finishStacking();
+		const std::pair<unsigned int, unsigned int> heapMapSize = simulator.getHeapMapSize();
+		const float* heapMap = simulator.getHeapMap();
+		const float height = *std::max_element(heapMap, heapMap + heapMapSize.first * heapMapSize.second);
+
+		std::cout << (acceleratedDescent ? "accelerated" : "plain") << "\t" << eightLikelihood << "\t" << stacked << "\t" << height
+			<< "\t" << double(simulator.getDescentStepCount() - stepsBefore) / batch
+			<< "\t" << 1e6 * std::chrono::duration<double>(end - start).count() / batch << std::endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const float eightLikelihood = argc > 1 ? std::stof(argv[1]) : 0.87f;
+	const unsigned int particles = argc > 2 ? static_cast<unsigned int>(std::stoul(argv[2])) : 400000u;
+
+	std::cout << "descent\teight_likelihood\tparticles\tpile_height\tsteps_per_particle\tmicroseconds_per_particle" << std::endl;
+	for (bool acceleratedDescent : {false, true}) {
+		runCone(acceleratedDescent, eightLikelihood, particles);
+	}
+
+	return 0;
+}
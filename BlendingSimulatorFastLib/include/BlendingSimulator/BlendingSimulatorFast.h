@@ -1,9 +1,13 @@
 #ifndef BlendingSimulatorFast_H
 #define BlendingSimulatorFast_H
 
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 #include "BlendingSimulator/BlendingSimulator.h"
+#include "detail/AliasTable.h"
+#include "detail/TiledHeightGrid.h"
 
 namespace blendingsimulator
 {
@@ -11,35 +15,163 @@ template<typename Parameters>
 class BlendingSimulatorFast : public BlendingSimulator<Parameters>
 {
 	public:
+		// Consecutive particles of identical parameters deposited in one column, heights in cells
+		struct LayerRun
+		{
+			int begin;
+			int end;
+			unsigned int parameterId;
+		};
+
+		// Vertical slice through the bed at one x position, parameter id per z and height cell or -1 for air
+		struct CrossSection
+		{
+			unsigned int width = 0;
+			unsigned int height = 0;
+			std::vector<int> parameterIds;
+		};
+
 		explicit BlendingSimulatorFast(SimulationParameters simulationParameters);
+		~BlendingSimulatorFast() override;
 
 		void clear() override;
 		void finishStacking() override;
 		bool reclaimingFinished() override;
-		Parameters reclaim(float position) override;
+		void reclaimInto(float position, Parameters& out) override;
+
+		unsigned int getReclaimAngleCount() override;
+		float getReclaimAngle(unsigned int angleIndex) override;
+		bool reclaimingFinished(unsigned int angleIndex) override;
+		void reclaimInto(unsigned int angleIndex, float position, Parameters& out) override;
+
+		// Only available in linear mode, material landing behind the returned position joins the first unreclaimed slice
+		using BlendingSimulator<Parameters>::finalizedReclaimPosition;
+		float finalizedReclaimPosition(unsigned int angleIndex, float stackerMinX) override;
+
+		// Heights are rounded to whole cells, every cell of material is a particle of composition for reclaiming and layers
+		void loadInitialHeightmap(const float* heights, const Parameters* composition = nullptr) override;
+
+		// Layer queries require trackLayers and must not run concurrently to stacking
+		const std::vector<LayerRun>& getColumnLayers(unsigned int xi, unsigned int zi) const;
+		const Parameters& getLayerParameters(unsigned int parameterId) const;
+		void getCrossSection(float x, CrossSection& out) const;
+
+		// Distributes the recorded layers onto reclaim slices as a reclaimer with a different angle would collect them
+		void reclaimLayers(float reclaimAngle, std::vector<Parameters>& slices);
+
+		// Cells descended by all particles since construction, measures the cost of the descent
+		uint64_t getDescentStepCount() const;
 
 	protected:
 		void stackSingle(float x, float z, const Parameters& parameters) override;
 		void updateHeapMap() override;
 
 	private:
-		// Size factor for calculating real world positions / sized from internal data
-		const float realWorldSizeFactor;
+		struct Offset
+		{
+			int i;
+			int j;
+		};
+
+		// Fall directions, the first four form the 4-neighbourhood
+		static constexpr const Offset offsets[] = {
+			{-1, 0},
+			{0, -1},
+			{0, +1},
+			{+1, 0},
+			{-1, -1},
+			{-1, +1},
+			{+1, -1},
+			{+1, +1}
+		};
+
+		// Lowest neighbour heights of a cell with bit masks of the offsets reaching them
+		struct DescentCell
+		{
+			int min4;
+			int min8;
+			uint8_t mask4;
+			uint8_t mask8;
+			bool valid;
+		};
+
+		// Slices and progress of the reclaimer for one reclaim angle
+		struct ReclaimState
+		{
+			float angle;
+			float tanAngle;
+
+			// Position up to which material has been reclaimed, keeps growing in the ring of continuous circular operation
+			double reclaimerPos;
+
+			// Slices passed by the reclaimer since the last deposit
+			double sweptSinceDeposit;
 
-		// Position up to which material has been reclaimed
-		float reclaimerPos;
+			// Variables for grouping the particles per cross section
+			std::vector<Parameters> slices;
 
-		// Tangent of reclaim angle
-		float tanReclaimAngle;
+			// Slices by which material at a certain height is shifted towards the reclaimer, grown on demand
+			std::vector<int> heightOffsets;
+
+			// Slice receiving all material of a horizontal reclaimer in linear mode, -1 otherwise
+			int fixedIndex;
+		};
+
+		// Size factor for calculating real world positions / sized from internal data
+		const float realWorldSizeFactor;
 
 		// Circumference of circular stockpile ridge
 		double circumference = 0.0;
 
 		// Variable tracking the height at each position for falling simulation
-		std::vector<std::vector<int>> stackedHeights;
+		TiledHeightGrid stackedHeights;
+
+		// Amount of reclaim slices along the bed or the circumference
+		int sliceCount;
+
+		// One state per reclaim angle, all filled in the same stacking pass
+		std::vector<ReclaimState> reclaimStates;
+
+		// Reclaim slice of ground level material in circular mode, computed per height grid tile on first use
+		std::vector<std::vector<int>> reclaimBaseIndexTiles;
+
+		// Columns per ground level slice in circular mode, extended by each height tile allocated before a geometric reclaim
+		std::vector<std::vector<int32_t>> reclaimBaseColumns;
+		std::vector<bool> reclaimBucketedTiles;
+
+		// Upper bound of all column heights since the last clear()
+		int maxHeight = 0;
+
+		// Cell offsets of the discharge footprint drawn with the alias table, empty for point discharge
+		std::vector<Offset> footprintOffsets;
+		AliasTable footprintTable;
+
+		// Distinct parameters referenced by layer runs
+		std::vector<Parameters> layerParameters;
+
+		// Runs per column, allocated per height grid tile on first deposit
+		std::vector<std::unique_ptr<std::vector<LayerRun>[]>> layerTiles;
+
+		// Descent cache per cell, allocated per height grid tile on first use and invalidated around height changes
+		std::vector<std::unique_ptr<DescentCell[]>> descentTiles;
+
+		uint64_t descentStepCount = 0;
 
-		// Variables for grouping the particles per cross section
-		std::vector<Parameters> reclaimParameters;
+		const DescentCell& getDescentCell(int xi, int zi);
+		void invalidateDescent(int xi, int zi);
+		void addLayer(int xi, int zi, int height, const Parameters& parameters);
+		void cutLayers(int xi, int zi, int height);
+		float getTanReclaimAngle(float reclaimAngle) const;
+		static int getReclaimHeightOffset(int height, float tanAngle);
+		void initializeReclaimStates();
+		void initializeFootprint();
+		const std::vector<int>& getReclaimBaseIndexTile(int xi, int zi);
+		int getReclaimBaseIndex(int xi, int zi);
+		void bucketReclaimBaseColumns();
+		int getReclaimIndex(ReclaimState& state, int baseIndex, int height);
+		int getDepositIndex(ReclaimState& state, int baseIndex, int height);
+		bool isReclaimRing() const;
+		void cutReclaimedHeights(ReclaimState& state, int64_t startPos, int64_t endPos);
 };
 }
 
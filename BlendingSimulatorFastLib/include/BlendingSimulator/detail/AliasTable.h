@@ -0,0 +1,84 @@
+#ifndef BLENDINGSIMULATOR_ALIASTABLE_H
+#define BLENDINGSIMULATOR_ALIASTABLE_H
+
+#include <stdexcept>
+#include <vector>
+
+#include "BlendingSimulator/RandomStream.h"
+
+namespace blendingsimulator
+{
+// Samples indices proportionally to fixed weights in constant time using Vose's alias method
+class AliasTable
+{
+	public:
+		AliasTable() = default;
+
+		explicit AliasTable(const std::vector<double>& weights)
+			: probabilities(weights.size())
+			, aliases(weights.size())
+		{
+			const int n = static_cast<int>(weights.size());
+			double sum = 0.0;
+			for (double weight : weights) {
+				if (weight < 0.0) {
+					throw std::invalid_argument("alias table weights must not be negative");
+				}
+				sum += weight;
+			}
+			if (n == 0 || sum <= 0.0) {
+				throw std::invalid_argument("alias table requires a positive weight");
+			}
+
+			// Scaled so that the average column holds exactly 1
+			std::vector<double> scaled(n);
+			std::vector<int> small;
+			std::vector<int> large;
+			for (int i = 0; i < n; i++) {
+				scaled[i] = weights[i] * n / sum;
+				(scaled[i] < 1.0 ? small : large).push_back(i);
+			}
+
+			// Every small column is filled up by the remainder of a large one
+			while (!small.empty() && !large.empty()) {
+				const int s = small.back();
+				const int l = large.back();
+				small.pop_back();
+				probabilities[s] = scaled[s];
+				aliases[s] = l;
+				scaled[l] -= 1.0 - scaled[s];
+				if (scaled[l] < 1.0) {
+					large.pop_back();
+					small.push_back(l);
+				}
+			}
+
+			// Columns left over by rounding errors are full
+			for (int i : large) {
+				probabilities[i] = 1.0;
+				aliases[i] = i;
+			}
+			for (int i : small) {
+				probabilities[i] = 1.0;
+				aliases[i] = i;
+			}
+		}
+
+		int size() const
+		{
+			return static_cast<int>(probabilities.size());
+		}
+
+		int sample(RandomStream& random) const
+		{
+			const int i = random.uniformInt(size());
+			return random.uniform() < probabilities[i] ? i : aliases[i];
+		}
+
+	private:
+		std::vector<double> probabilities;
+		std::vector<int> aliases;
+};
+}
+
+#endif
@@ -1,55 +1,93 @@
+#include <cmath>
 #include <limits>
-#include <random>
+#include <stdexcept>
 #include <thread>
 
 template<typename Parameters>
 blendingsimulator::BlendingSimulatorFast<Parameters>::BlendingSimulatorFast(SimulationParameters simulationParameters)
 	: BlendingSimulator<Parameters>(simulationParameters)
-	, reclaimerPos(0.0f)
 	, realWorldSizeFactor(1.0f / std::pow(simulationParameters.particlesPerCubicMeter, 1.0f / 3.0f))
 {
-	if (std::abs(90.0f - simulationParameters.reclaimAngle) < 0.01) {
-		tanReclaimAngle = 1e100;
-	} else {
-		tanReclaimAngle = float(std::tan(simulationParameters.reclaimAngle * std::atan(1.0) * 4.0 / 180.0));
-	}
-
+	// Heap map is allocated on first request only as the height grid is sparse
 	this->initializeHeapMap(
 		(unsigned int)(simulationParameters.heapWorldSizeX / realWorldSizeFactor + 0.5),
-		(unsigned int)(simulationParameters.heapWorldSizeZ / realWorldSizeFactor + 0.5)
+		(unsigned int)(simulationParameters.heapWorldSizeZ / realWorldSizeFactor + 0.5),
+		false
 	);
 
-	// Warning: stackedHeights organized first x than z while heap map is first z than x!
-	stackedHeights.resize(this->heapSizeX + 2);
-	for (unsigned int x = 0; x < this->heapSizeX + 2; x++) {
-		stackedHeights[x].resize(this->heapSizeZ + 2);
-	}
+	stackedHeights = TiledHeightGrid(this->heapSizeX, this->heapSizeZ);
 
 	if (simulationParameters.circular) {
 		circumference = 2.0 * this->pi * 0.25 * std::min(simulationParameters.heapWorldSizeX, simulationParameters.heapWorldSizeZ);
-		reclaimParameters.resize(static_cast<unsigned int>(circumference / realWorldSizeFactor + 0.5));
+		sliceCount = static_cast<int>(circumference / realWorldSizeFactor + 0.5);
 	} else {
-		reclaimParameters.resize(this->heapSizeX);
+		sliceCount = static_cast<int>(this->heapSizeX);
 	}
 
+	initializeReclaimStates();
+	initializeFootprint();
+
+	if (simulationParameters.geometricReclaim) {
+		// Material below a face overhanging the reclaimer could not stay in place
+		for (const ReclaimState& state : reclaimStates) {
+			if (state.angle <= 0.0f || state.angle > 90.0f) {
+				throw std::invalid_argument("geometric reclaim requires reclaim angles in (0, 90]");
+			}
+		}
+		if (reclaimStates.size() > 1) {
+			throw std::invalid_argument("geometric reclaim supports a single reclaim angle only");
+		}
+	}
+
+	if (simulationParameters.acceleratedDescent) {
+		descentTiles.resize(stackedHeights.getTileCount());
+	}
+
+	if (simulationParameters.trackLayers) {
+		layerTiles.resize(stackedHeights.getTileCount());
+	}
+
+	// Deposits are logged in cells
+	this->openDepositLog(realWorldSizeFactor);
+
 	clear();
 }
 
+template<typename Parameters>
+blendingsimulator::BlendingSimulatorFast<Parameters>::~BlendingSimulatorFast()
+{
+	this->stopStackingWorker();
+}
+
 template<typename Parameters>
 void blendingsimulator::BlendingSimulatorFast<Parameters>::clear()
 {
-	std::fill(stackedHeights[0].begin(), stackedHeights[0].end(), std::numeric_limits<int>::max());
-	for (unsigned int x = 1; x < this->heapSizeX + 1; x++) {
-		for (unsigned int z = 1; z < this->heapSizeZ + 1; z++) {
-			stackedHeights[x][z] = 0;
+	stackedHeights.clear();
+	this->resetStacking();
+
+	maxHeight = 0;
+
+	for (ReclaimState& state : reclaimStates) {
+		state.reclaimerPos = 0.0;
+		state.sweptSinceDeposit = 0.0;
+		for (Parameters& slice : state.slices) {
+			slice.clear();
 		}
-		stackedHeights[x][0] = std::numeric_limits<int>::max();
-		stackedHeights[x][this->heapSizeZ + 1] = std::numeric_limits<int>::max();
 	}
-	std::fill(stackedHeights[this->heapSizeX + 1].begin(), stackedHeights[this->heapSizeX + 1].end(), std::numeric_limits<int>::max());
 
-	for (Parameters& reclaimParameter : reclaimParameters) {
-		reclaimParameter.clear();
+	for (auto& tile : descentTiles) {
+		if (tile) {
+			std::fill(tile.get(), tile.get() + TiledHeightGrid::tileCellCount, DescentCell());
+		}
+	}
+
+	layerParameters.clear();
+	for (auto& tile : layerTiles) {
+		if (tile) {
+			for (int cell = 0; cell < TiledHeightGrid::tileCellCount; cell++) {
+				tile[cell].clear();
+			}
+		}
 	}
 
 	{
@@ -70,39 +108,78 @@ void blendingsimulator::BlendingSimulatorFast<Parameters>::clear()
 template<typename Parameters>
 void blendingsimulator::BlendingSimulatorFast<Parameters>::finishStacking()
 {
-	// Nothing to do
+	this->flushDepositLog();
 }
 
 template<typename Parameters>
 bool blendingsimulator::BlendingSimulatorFast<Parameters>::reclaimingFinished()
 {
-	return int(reclaimerPos / realWorldSizeFactor + 0.5) >= reclaimParameters.size();
+	return reclaimingFinished(0);
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorFast<Parameters>::reclaimInto(float position, Parameters& out)
+{
+	reclaimInto(0, position, out);
+}
+
+template<typename Parameters>
+unsigned int blendingsimulator::BlendingSimulatorFast<Parameters>::getReclaimAngleCount()
+{
+	return static_cast<unsigned int>(reclaimStates.size());
 }
 
 template<typename Parameters>
-Parameters blendingsimulator::BlendingSimulatorFast<Parameters>::reclaim(float position)
+float blendingsimulator::BlendingSimulatorFast<Parameters>::getReclaimAngle(unsigned int angleIndex)
 {
-	double oldPos = reclaimerPos / realWorldSizeFactor;
+	return reclaimStates.at(angleIndex).angle;
+}
+
+template<typename Parameters>
+bool blendingsimulator::BlendingSimulatorFast<Parameters>::reclaimingFinished(unsigned int angleIndex)
+{
+	const ReclaimState& state = reclaimStates.at(angleIndex);
+	if (isReclaimRing()) {
+		// Every slice has been passed completely since the last deposit
+		return state.sweptSinceDeposit > double(sliceCount);
+	}
+
+	return int(state.reclaimerPos / realWorldSizeFactor + 0.5) >= sliceCount;
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorFast<Parameters>::reclaimInto(unsigned int angleIndex, float position, Parameters& out)
+{
+	BLENDINGSIMULATOR_TRACE_SCOPE("reclaim");
+	BLENDINGSIMULATOR_ALLOCATION_PHASE(Reclaim);
+
+	ReclaimState& state = reclaimStates.at(angleIndex);
+	std::vector<Parameters>& slices = state.slices;
+
+	// Positions keep growing in the ring, slice k is stored at k modulo the slice count
+	const bool ring = isReclaimRing();
+	double oldPos = state.reclaimerPos / realWorldSizeFactor;
 	double newPos = position / realWorldSizeFactor;
-	int startPos = static_cast<int>(oldPos);
-	int endPos = static_cast<int>(newPos);
+	int64_t startPos = static_cast<int64_t>(oldPos);
+	int64_t endPos = static_cast<int64_t>(newPos);
 
 	if (startPos < 0) {
 		startPos = 0;
 	}
 
-	if (endPos > reclaimParameters.size()) {
-		endPos = static_cast<int>(reclaimParameters.size());
+	if (!ring && endPos > sliceCount) {
+		endPos = sliceCount;
 	}
 
-	Parameters p;
-	for (int i = startPos; i < endPos; i++) {
-		p.push(reclaimParameters[i]);
-		reclaimParameters[i].clear();
+	out.clear();
+	for (int64_t i = startPos; i < std::min(endPos, startPos + sliceCount); i++) {
+		auto& r = slices[i % sliceCount];
+		out.push(r);
+		r.clear();
 	}
 
-	if (endPos < reclaimParameters.size()) {
-		auto& r = reclaimParameters[endPos];
+	if (ring || endPos < sliceCount) {
+		auto& r = slices[endPos % sliceCount];
 		double popVolume = 0.0f;
 		if (startPos == endPos) {
 			double missingPart = oldPos - double(endPos);
@@ -116,26 +193,109 @@ Parameters blendingsimulator::BlendingSimulatorFast<Parameters>::reclaim(float p
 		} else {
 			popVolume = r.getVolume() * (newPos - double(endPos));
 		}
-		p.push(r.pop(popVolume));
+		r.pop(popVolume, out);
+	}
+
+	if (this->simulationParameters.geometricReclaim && endPos > startPos) {
+		cutReclaimedHeights(state, startPos, endPos);
 	}
 
-	reclaimerPos = position;
-	return p;
+	if (newPos > oldPos) {
+		state.sweptSinceDeposit += newPos - oldPos;
+	}
+	state.reclaimerPos = position;
+}
+
+template<typename Parameters>
+float blendingsimulator::BlendingSimulatorFast<Parameters>::finalizedReclaimPosition(unsigned int angleIndex, float stackerMinX)
+{
+	if (this->simulationParameters.circular) {
+		throw std::logic_error("finalized reclaim positions are only available in linear mode");
+	}
+
+	const ReclaimState& state = reclaimStates.at(angleIndex);
+
+	// Heights strictly decrease along the descent so a particle dropped at the stacker travels at most maxHeight cells
+	// towards the reclaimer and rests at most maxHeight high, shifting its slice by the largest height offset
+	// Growing heaps may still reach behind this estimate, such deposits end up in the first slice not yet reclaimed
+	const int stackerCell = std::max(0, std::min(int(stackerMinX / realWorldSizeFactor + 0.5), sliceCount - 1));
+	const int lowestCell = state.fixedIndex >= 0 ? state.fixedIndex : stackerCell - maxHeight;
+	const int lowestSlice = lowestCell - std::max(0, getReclaimHeightOffset(maxHeight, state.tanAngle));
+
+	// The last slice collects everything deposited behind the reclaimer once it got there and stays open until the end
+	return float(std::max(0, std::min(lowestSlice, sliceCount - 1))) * realWorldSizeFactor;
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorFast<Parameters>::loadInitialHeightmap(const float* heights, const Parameters* composition)
+{
+	if (!heights) {
+		throw std::invalid_argument("initial heights must not be null");
+	}
+
+	Parameters particle;
+	if (composition) {
+		if (!(composition->getVolume() > 0.0)) {
+			throw std::invalid_argument("initial composition requires a positive volume");
+		}
+		particle.assign(*composition, 1.0 / this->simulationParameters.particlesPerCubicMeter);
+	}
+
+	// Descent cache, layers and reclaim slices start over as after clear()
+	clear();
+
+	for (unsigned int zi = 0; zi < this->heapSizeZ; zi++) {
+		for (unsigned int xi = 0; xi < this->heapSizeX; xi++) {
+			const float height = heights[size_t(zi) * this->heapSizeX + xi];
+			const int h = height > 0.0f ? int(height / realWorldSizeFactor + 0.5f) : 0;
+			if (h <= 0) {
+				continue;
+			}
+
+			stackedHeights.set(xi, zi, h);
+			maxHeight = std::max(maxHeight, h);
+
+			if (!composition) {
+				continue;
+			}
+
+			const int baseIndex = getReclaimBaseIndex(xi, zi);
+			for (int y = 0; y < h; y++) {
+				if (this->simulationParameters.trackLayers) {
+					addLayer(xi, zi, y, particle);
+				}
+				for (ReclaimState& state : reclaimStates) {
+					state.slices[getDepositIndex(state, baseIndex, y)].push(particle);
+				}
+			}
+		}
+	}
 }
 
 template<typename Parameters>
 void blendingsimulator::BlendingSimulatorFast<Parameters>::stackSingle(float x, float z, const Parameters& parameters)
 {
+	BLENDINGSIMULATOR_ALLOCATION_PHASE(Fall);
+
 	while (this->paused.load()) {
 		std::this_thread::sleep_for(std::chrono::milliseconds(50));
 	}
 
-	int xi = std::max(0, std::min(int(x / realWorldSizeFactor + 0.5), int(this->heapSizeX - 1))) + 1;
-	int zi = std::max(0, std::min(int(z / realWorldSizeFactor + 0.5), int(this->heapSizeZ - 1))) + 1;
+	RandomStream random = this->nextParticleRandom();
+
+	int xi = int(x / realWorldSizeFactor + 0.5);
+	int zi = int(z / realWorldSizeFactor + 0.5);
+	if (!footprintOffsets.empty()) {
+		const Offset& offset = footprintOffsets[footprintTable.sample(random)];
+		xi += offset.i;
+		zi += offset.j;
+	}
+	xi = std::max(0, std::min(xi, int(this->heapSizeX - 1)));
+	zi = std::max(0, std::min(zi, int(this->heapSizeZ - 1)));
 
 	int minHeightX;
 	int minHeightZ;
-	int minHeight = stackedHeights[xi][zi];
+	int minHeight = stackedHeights.get(xi, zi);
 
 	// TODO replace variable slow by single step button on interface
 	bool slow = false;
@@ -145,6 +305,7 @@ void blendingsimulator::BlendingSimulatorFast<Parameters>::stackSingle(float x,
 	Particle<Parameters>* particle = nullptr;
 
 	if (this->simulationParameters.visualize) {
+		BLENDINGSIMULATOR_ALLOCATION_PHASE(Output);
 		particle = new Particle<Parameters>();
 		particle->parameters = parameters;
 		particle->frozen = false;
@@ -153,9 +314,9 @@ void blendingsimulator::BlendingSimulatorFast<Parameters>::stackSingle(float x,
 
 		if (slow) {
 			particle->position = Vector3(
-				(float(xi) - 0.5f) * realWorldSizeFactor,
+				(float(xi) + 0.5f) * realWorldSizeFactor,
 				(float(minHeight) + 0.5f) * realWorldSizeFactor,
-				(float(zi) - 0.5f) * realWorldSizeFactor
+				(float(zi) + 0.5f) * realWorldSizeFactor
 			);
 
 			{
@@ -172,54 +333,71 @@ void blendingsimulator::BlendingSimulatorFast<Parameters>::stackSingle(float x,
 		minHeightX = -1;
 		minHeightZ = -1;
 
-		struct Offset
-		{
-			int i;
-			int j;
-		};
-		constexpr const static Offset offsets[] = {
-			{-1, 0},
-			{0, -1},
-			{0, +1},
-			{+1, 0},
-			{-1, -1},
-			{-1, +1},
-			{+1, -1},
-			{+1, +1}
-		};
-
-		static std::random_device rd;
-		static std::default_random_engine generator(rd());
-		static std::uniform_real_distribution<> coneDistribution(0.0, 1.0);
-		const int offsetsCount = coneDistribution(generator) > this->simulationParameters.eightLikelihood ? 4 : 8; // This results in cones instead of pyramids
-
-		static std::uniform_int_distribution<int> randomnessDistribution(0, 7);
-		const int r = randomnessDistribution(generator);
-
-		for (int o = 0; o < offsetsCount; o++) {
-			const Offset& offset = offsets[(o + r) % offsetsCount];
-			const int tx = xi + offset.i;
-			const int tz = zi + offset.j;
-			const int lh = stackedHeights[tx][tz];
-
-			if (lh < minHeight) {
-				minHeightX = tx;
-				minHeightZ = tz;
-				minHeight = lh;
+		if (this->simulationParameters.acceleratedDescent) {
+			const DescentCell& cell = getDescentCell(xi, zi);
+
+			// Without any lower neighbour the particle stops whatever the random draws would be
+			if (cell.min8 < minHeight) {
+				int o = -1;
+
+				if (cell.min4 < minHeight && cell.mask4 == cell.mask8 && (cell.mask4 & (cell.mask4 - 1)) == 0) {
+					// Single steepest neighbour for both neighbourhoods so the draws cannot change the direction
+					while (!(cell.mask4 & (1 << ++o))) {
+					}
+				} else {
+					const int offsetsCount = random.uniform() > this->simulationParameters.eightLikelihood ? 4 : 8; // This results in cones instead of pyramids
+					const int r = random.uniformInt(8);
+					const int lowest = offsetsCount == 4 ? cell.min4 : cell.min8;
+					const uint8_t mask = offsetsCount == 4 ? cell.mask4 : cell.mask8;
+
+					// Same tie breaking as probing the neighbours in rotated order
+					if (lowest < minHeight) {
+						for (int k = 0; k < offsetsCount; k++) {
+							const int candidate = (k + r) % offsetsCount;
+							if (mask & (1 << candidate)) {
+								o = candidate;
+								break;
+							}
+						}
+					}
+				}
+
+				if (o >= 0) {
+					minHeightX = xi + offsets[o].i;
+					minHeightZ = zi + offsets[o].j;
+					minHeight = stackedHeights.get(minHeightX, minHeightZ);
+				}
+			}
+		} else {
+			const int offsetsCount = random.uniform() > this->simulationParameters.eightLikelihood ? 4 : 8; // This results in cones instead of pyramids
+			const int r = random.uniformInt(8);
+
+			for (int o = 0; o < offsetsCount; o++) {
+				const Offset& offset = offsets[(o + r) % offsetsCount];
+				const int tx = xi + offset.i;
+				const int tz = zi + offset.j;
+				const int lh = stackedHeights.get(tx, tz);
+
+				if (lh < minHeight) {
+					minHeightX = tx;
+					minHeightZ = tz;
+					minHeight = lh;
+				}
 			}
 		}
 
 		if (minHeightX >= 0) {
 			xi = minHeightX;
 			zi = minHeightZ;
+			descentStepCount++;
 
 			if (this->simulationParameters.visualize && slow) {
 				{
 					std::lock_guard<std::mutex> lock(this->outputParticlesMutex);
 					particle->position = Vector3(
-						(float(xi) - 0.5f) * realWorldSizeFactor,
+						(float(xi) + 0.5f) * realWorldSizeFactor,
 						(float(minHeight) + 0.5f) * realWorldSizeFactor,
-						(float(zi) - 0.5f) * realWorldSizeFactor
+						(float(zi) + 0.5f) * realWorldSizeFactor
 					);
 				}
 
@@ -228,8 +406,14 @@ void blendingsimulator::BlendingSimulatorFast<Parameters>::stackSingle(float x,
 		}
 	} while (minHeightX >= 0);
 
+	BLENDINGSIMULATOR_ALLOCATION_PHASE(Stack);
+
 	// Update height
-	stackedHeights[xi][zi] = minHeight + 1;
+	stackedHeights.set(xi, zi, minHeight + 1);
+	maxHeight = std::max(maxHeight, minHeight + 1);
+	if (this->simulationParameters.acceleratedDescent) {
+		invalidateDescent(xi, zi);
+	}
 
 	if (this->simulationParameters.visualize) {
 		{
@@ -240,9 +424,9 @@ void blendingsimulator::BlendingSimulatorFast<Parameters>::stackSingle(float x,
 			}
 
 			particle->position = Vector3(
-				(float(xi) - 0.5f) * realWorldSizeFactor,
+				(float(xi) + 0.5f) * realWorldSizeFactor,
 				(float(minHeight) + 0.5f) * realWorldSizeFactor,
-				(float(zi) - 0.5f) * realWorldSizeFactor
+				(float(zi) + 0.5f) * realWorldSizeFactor
 			);
 			particle->frozen = true;
 			this->inactiveOutputParticles.push_back(particle);
@@ -253,65 +437,492 @@ void blendingsimulator::BlendingSimulatorFast<Parameters>::stackSingle(float x,
 		}
 	}
 
-	int reclaimIndex = 0;
+	if (this->simulationParameters.trackLayers) {
+		addLayer(xi, zi, minHeight, parameters);
+	}
+
+	this->logDeposit(xi, minHeight, zi, parameters);
 
 	// Prepare reclaiming
-	if (this->simulationParameters.circular) {
-		// Position is along the radius
+	const int baseIndex = getReclaimBaseIndex(xi, zi);
+	for (ReclaimState& state : reclaimStates) {
+		state.slices[getDepositIndex(state, baseIndex, minHeight)].push(parameters);
+		state.sweptSinceDeposit = 0.0;
+	}
+}
 
-		double dx = double(xi - 0.5f) * realWorldSizeFactor - 0.5 * this->simulationParameters.heapWorldSizeX + 0.5f;
-		double dz = double(zi - 0.5f) * realWorldSizeFactor - 0.5 * this->simulationParameters.heapWorldSizeZ + 0.5f;
-		double posOnCircumference = 0.5 * (1.0 - std::atan2(dz, dx) / this->pi) * this->circumference;
+template<typename Parameters>
+const std::vector<typename blendingsimulator::BlendingSimulatorFast<Parameters>::LayerRun>&
+blendingsimulator::BlendingSimulatorFast<Parameters>::getColumnLayers(unsigned int xi, unsigned int zi) const
+{
+	static const std::vector<LayerRun> noLayers;
 
-		if (tanReclaimAngle > 1e10) {
-			// Vertical
-		} else if (tanReclaimAngle < 1e-10) {
-			// Horizontal
-			// Ignore horizontal reclaiming for circular stockpiles - it is useless anyway
-		} else {
-			posOnCircumference -= float(minHeight) * realWorldSizeFactor / tanReclaimAngle;
+	if (layerTiles.empty() || xi >= this->heapSizeX || zi >= this->heapSizeZ) {
+		return noLayers;
+	}
+
+	const auto& tile = layerTiles[stackedHeights.getTileIndex(xi, zi)];
+	return tile ? tile[TiledHeightGrid::getCellIndex(xi, zi)] : noLayers;
+}
+
+template<typename Parameters>
+const Parameters& blendingsimulator::BlendingSimulatorFast<Parameters>::getLayerParameters(unsigned int parameterId) const
+{
+	return layerParameters.at(parameterId);
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorFast<Parameters>::getCrossSection(float x, CrossSection& out) const
+{
+	const unsigned int xi = static_cast<unsigned int>(std::max(0, std::min(int(x / realWorldSizeFactor + 0.5), int(this->heapSizeX - 1))));
+
+	out.width = this->heapSizeZ;
+	out.height = 0;
+	for (unsigned int zi = 0; zi < this->heapSizeZ; zi++) {
+		const std::vector<LayerRun>& column = getColumnLayers(xi, zi);
+		if (!column.empty()) {
+			out.height = std::max(out.height, static_cast<unsigned int>(column.back().end));
+		}
+	}
+
+	out.parameterIds.assign(size_t(out.width) * out.height, -1);
+	for (unsigned int zi = 0; zi < this->heapSizeZ; zi++) {
+		for (const LayerRun& run : getColumnLayers(xi, zi)) {
+			for (int h = std::max(0, run.begin); h < run.end; h++) {
+				out.parameterIds[size_t(h) * out.width + zi] = static_cast<int>(run.parameterId);
+			}
+		}
+	}
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorFast<Parameters>::reclaimLayers(float reclaimAngle, std::vector<Parameters>& slices)
+{
+	const int n = sliceCount;
+	const float tanAngle = getTanReclaimAngle(reclaimAngle);
+	const bool circular = this->simulationParameters.circular;
+
+	slices.resize(sliceCount);
+	for (Parameters& slice : slices) {
+		slice.clear();
+	}
+
+	if (layerTiles.empty()) {
+		return;
+	}
+
+	for (int x0 = 0; x0 < int(this->heapSizeX); x0 += TiledHeightGrid::tileSize) {
+		for (int z0 = 0; z0 < int(this->heapSizeZ); z0 += TiledHeightGrid::tileSize) {
+			const auto& tile = layerTiles[stackedHeights.getTileIndex(x0, z0)];
+			if (!tile) {
+				continue;
+			}
+
+			for (int x = x0; x < std::min(x0 + TiledHeightGrid::tileSize, int(this->heapSizeX)); x++) {
+				for (int z = z0; z < std::min(z0 + TiledHeightGrid::tileSize, int(this->heapSizeZ)); z++) {
+					const int cell = TiledHeightGrid::getCellIndex(x, z);
+					int baseIndex;
+					if (circular) {
+						baseIndex = getReclaimBaseIndexTile(x, z)[cell];
+					} else if (tanAngle < 1e-10) {
+						// Horizontal
+						baseIndex = reclaimAngle < 90.0f ? 0 : n - 1;
+					} else {
+						baseIndex = x;
+					}
+
+					for (const LayerRun& run : tile[cell]) {
+						const Parameters& parameters = layerParameters[run.parameterId];
+
+						// Heights of a run mostly share slices so they are pushed in groups
+						int groupIndex = -1;
+						int groupSize = 0;
+						for (int h = run.begin; h <= run.end; h++) {
+							int index = -1;
+							if (h < run.end) {
+								index = baseIndex - getReclaimHeightOffset(h, tanAngle);
+								index = circular ? ((index % n) + n) % n : std::max(0, std::min(index, n - 1));
+							}
+
+							if (index != groupIndex) {
+								if (groupSize > 0) {
+									slices[groupIndex].push(parameters, groupSize * parameters.getVolume());
+								}
+								groupIndex = index;
+								groupSize = 0;
+							}
+							groupSize++;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+template<typename Parameters>
+uint64_t blendingsimulator::BlendingSimulatorFast<Parameters>::getDescentStepCount() const
+{
+	return descentStepCount;
+}
+
+template<typename Parameters>
+const typename blendingsimulator::BlendingSimulatorFast<Parameters>::DescentCell&
+blendingsimulator::BlendingSimulatorFast<Parameters>::getDescentCell(int xi, int zi)
+{
+	auto& tile = descentTiles[stackedHeights.getTileIndex(xi, zi)];
+	if (!tile) {
+		tile.reset(new DescentCell[TiledHeightGrid::tileCellCount]());
+	}
+
+	DescentCell& cell = tile[TiledHeightGrid::getCellIndex(xi, zi)];
+	if (!cell.valid) {
+		cell.min4 = std::numeric_limits<int>::max();
+		cell.mask4 = 0;
+		for (int o = 0; o < 8; o++) {
+			if (o == 4) {
+				cell.min8 = cell.min4;
+				cell.mask8 = cell.mask4;
+			}
+
+			int& lowest = o < 4 ? cell.min4 : cell.min8;
+			uint8_t& mask = o < 4 ? cell.mask4 : cell.mask8;
+			const int h = stackedHeights.get(xi + offsets[o].i, zi + offsets[o].j);
+			if (h < lowest) {
+				lowest = h;
+				mask = uint8_t(1 << o);
+			} else if (h == lowest) {
+				mask |= uint8_t(1 << o);
+			}
+		}
+		cell.valid = true;
+	}
+
+	return cell;
+}
+
+// Cached descents of the surrounding cells depend on the height of this cell
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorFast<Parameters>::invalidateDescent(int xi, int zi)
+{
+	for (const Offset& offset : offsets) {
+		const int x = xi + offset.i;
+		const int z = zi + offset.j;
+		if (x < 0 || z < 0 || x >= int(this->heapSizeX) || z >= int(this->heapSizeZ)) {
+			continue;
 		}
 
-		reclaimIndex = (unsigned int)(posOnCircumference / realWorldSizeFactor + 0.5);
+		auto& tile = descentTiles[stackedHeights.getTileIndex(x, z)];
+		if (tile) {
+			tile[TiledHeightGrid::getCellIndex(x, z)].valid = false;
+		}
+	}
+}
 
-		// Acquire positive modulo
-		int n = static_cast<int>(reclaimParameters.size());
-		reclaimIndex = (reclaimIndex % n + n) % n;
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorFast<Parameters>::addLayer(int xi, int zi, int height, const Parameters& parameters)
+{
+	auto& tile = layerTiles[stackedHeights.getTileIndex(xi, zi)];
+	if (!tile) {
+		tile.reset(new std::vector<LayerRun>[TiledHeightGrid::tileCellCount]);
+	}
+
+	if (layerParameters.empty() || layerParameters.back() != parameters) {
+		layerParameters.push_back(parameters);
+	}
+	const unsigned int parameterId = static_cast<unsigned int>(layerParameters.size() - 1);
+
+	std::vector<LayerRun>& column = tile[TiledHeightGrid::getCellIndex(xi, zi)];
+	if (!column.empty() && column.back().end == height && column.back().parameterId == parameterId) {
+		column.back().end++;
 	} else {
-		reclaimIndex = xi - 1;
+		column.push_back({height, height + 1, parameterId});
+	}
+}
 
-		if (tanReclaimAngle > 1e10) {
-			// Vertical
-		} else if (tanReclaimAngle < 1e-10) {
-			// Horizontal
-			if (this->simulationParameters.reclaimAngle < 90.0f) {
-				reclaimIndex = 0;
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorFast<Parameters>::cutLayers(int xi, int zi, int height)
+{
+	auto& tile = layerTiles[stackedHeights.getTileIndex(xi, zi)];
+	if (!tile) {
+		return;
+	}
+
+	std::vector<LayerRun>& column = tile[TiledHeightGrid::getCellIndex(xi, zi)];
+	while (!column.empty() && column.back().begin >= height) {
+		column.pop_back();
+	}
+	if (!column.empty() && column.back().end > height) {
+		column.back().end = height;
+	}
+}
+
+template<typename Parameters>
+float blendingsimulator::BlendingSimulatorFast<Parameters>::getTanReclaimAngle(float reclaimAngle) const
+{
+	if (std::abs(90.0f - reclaimAngle) < 0.01) {
+		return 1e100;
+	}
+
+	return float(std::tan(reclaimAngle * std::atan(1.0) * 4.0 / 180.0));
+}
+
+template<typename Parameters>
+int blendingsimulator::BlendingSimulatorFast<Parameters>::getReclaimHeightOffset(int height, float tanAngle)
+{
+	if (tanAngle > 1e10) {
+		// Vertical
+		return 0;
+	} else if (tanAngle < 1e-10) {
+		// Horizontal
+		// Handled by base indices in linear mode, useless for circular stockpiles anyway
+		return 0;
+	}
+
+	return int(float(height) / tanAngle + 0.5f);
+}
+
+// Footprint cells within three standard deviations of the Gaussian or covered by the strip, weighted by their share of material
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorFast<Parameters>::initializeFootprint()
+{
+	const SimulationParameters& p = this->simulationParameters;
+	if (p.dischargeFootprint == DischargeFootprint::Point) {
+		return;
+	}
+
+	if (!(p.dischargeSizeX > 0.0f) || !(p.dischargeSizeZ > 0.0f)) {
+		throw std::invalid_argument("discharge footprint sizes must be positive");
+	}
+
+	const bool gaussian = p.dischargeFootprint == DischargeFootprint::Gaussian;
+	const double sizeX = p.dischargeSizeX / realWorldSizeFactor;
+	const double sizeZ = p.dischargeSizeZ / realWorldSizeFactor;
+	const int radiusX = gaussian ? int(3.0 * sizeX) : int(std::ceil(0.5 * sizeX - 0.5));
+	const int radiusZ = gaussian ? int(3.0 * sizeZ) : int(std::ceil(0.5 * sizeZ - 0.5));
+
+	// Share of cell i covered by a strip of the given size centered on cell 0
+	auto coverage = [](int i, double size) {
+		return std::max(0.0, std::min(double(i) + 0.5, 0.5 * size) - std::max(double(i) - 0.5, -0.5 * size));
+	};
+
+	std::vector<double> weights;
+	for (int i = -radiusX; i <= radiusX; i++) {
+		for (int j = -radiusZ; j <= radiusZ; j++) {
+			double weight;
+			if (gaussian) {
+				const double r2 = (i * i) / (sizeX * sizeX) + (j * j) / (sizeZ * sizeZ);
+				if (r2 > 9.0) {
+					continue;
+				}
+				weight = std::exp(-0.5 * r2);
 			} else {
-				reclaimIndex = static_cast<int>(reclaimParameters.size() - 1);
+				weight = coverage(i, sizeX) * coverage(j, sizeZ);
 			}
+			footprintOffsets.push_back({i, j});
+			weights.push_back(weight);
+		}
+	}
+
+	footprintTable = AliasTable(weights);
+}
+
+// Precompute everything the reclaim slice depends on so that stacking only needs to combine two table entries per angle
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorFast<Parameters>::initializeReclaimStates()
+{
+	std::vector<float> angles = this->simulationParameters.reclaimAngles;
+	if (angles.empty()) {
+		angles.push_back(this->simulationParameters.reclaimAngle);
+	}
+
+	reclaimStates.resize(angles.size());
+	for (size_t i = 0; i < angles.size(); i++) {
+		ReclaimState& state = reclaimStates[i];
+		state.angle = angles[i];
+		state.tanAngle = getTanReclaimAngle(angles[i]);
+		state.reclaimerPos = 0.0;
+		state.sweptSinceDeposit = 0.0;
+		state.slices.resize(sliceCount);
+		state.heightOffsets.clear();
+		// Heaps rarely outgrow the bed extent, so the table does not reallocate while stacking
+		state.heightOffsets.reserve(this->heapSizeX + this->heapSizeZ);
+
+		if (!this->simulationParameters.circular && state.tanAngle < 1e-10) {
+			// Horizontal
+			state.fixedIndex = state.angle < 90.0f ? 0 : sliceCount - 1;
 		} else {
-			reclaimIndex -= int(float(minHeight) / tanReclaimAngle + 0.5f);
+			state.fixedIndex = -1;
 		}
+	}
+
+	if (this->simulationParameters.circular) {
+		reclaimBaseIndexTiles.clear();
+		reclaimBaseIndexTiles.resize(stackedHeights.getTileCount());
+	}
+}
+
+template<typename Parameters>
+const std::vector<int>& blendingsimulator::BlendingSimulatorFast<Parameters>::getReclaimBaseIndexTile(int xi, int zi)
+{
+	std::vector<int>& tile = reclaimBaseIndexTiles[stackedHeights.getTileIndex(xi, zi)];
+	if (!tile.empty()) {
+		return tile;
+	}
 
-		if (reclaimIndex < 0) {
-			reclaimIndex = 0;
+	// Position is along the radius
+	const int n = sliceCount;
+	const int x0 = xi & ~TiledHeightGrid::tileMask;
+	const int z0 = zi & ~TiledHeightGrid::tileMask;
+	tile.resize(TiledHeightGrid::tileCellCount, 0);
+	for (int x = x0; x < std::min(x0 + TiledHeightGrid::tileSize, int(this->heapSizeX)); x++) {
+		for (int z = z0; z < std::min(z0 + TiledHeightGrid::tileSize, int(this->heapSizeZ)); z++) {
+			double dx = (double(x) + 0.5) * realWorldSizeFactor - 0.5 * this->simulationParameters.heapWorldSizeX + 0.5f;
+			double dz = (double(z) + 0.5) * realWorldSizeFactor - 0.5 * this->simulationParameters.heapWorldSizeZ + 0.5f;
+			double posOnCircumference = 0.5 * (1.0 - std::atan2(dz, dx) / this->pi) * this->circumference;
+			tile[TiledHeightGrid::getCellIndex(x, z)] = int(posOnCircumference / realWorldSizeFactor + 0.5) % n;
 		}
+	}
+
+	return tile;
+}
+
+// Reclaim slice of ground level material which is independent of the reclaim angle
+template<typename Parameters>
+int blendingsimulator::BlendingSimulatorFast<Parameters>::getReclaimBaseIndex(int xi, int zi)
+{
+	if (this->simulationParameters.circular) {
+		return getReclaimBaseIndexTile(xi, zi)[TiledHeightGrid::getCellIndex(xi, zi)];
+	}
 
-		if (reclaimIndex >= reclaimParameters.size()) {
-			reclaimIndex = static_cast<int>(reclaimParameters.size() - 1);
+	return xi;
+}
+
+// Columns of unallocated tiles are at ground level and never cut, so only allocated tiles are bucketed
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorFast<Parameters>::bucketReclaimBaseColumns()
+{
+	if (reclaimBaseColumns.empty()) {
+		reclaimBaseColumns.resize(sliceCount);
+		reclaimBucketedTiles.assign(stackedHeights.getTileCount(), false);
+	}
+
+	for (int z0 = 0; z0 < int(this->heapSizeZ); z0 += TiledHeightGrid::tileSize) {
+		for (int x0 = 0; x0 < int(this->heapSizeX); x0 += TiledHeightGrid::tileSize) {
+			const size_t tileIndex = stackedHeights.getTileIndex(x0, z0);
+			if (reclaimBucketedTiles[tileIndex] || !stackedHeights.isTileAllocated(tileIndex)) {
+				continue;
+			}
+
+			reclaimBucketedTiles[tileIndex] = true;
+			const std::vector<int>& tile = getReclaimBaseIndexTile(x0, z0);
+			for (int zi = z0; zi < std::min(z0 + TiledHeightGrid::tileSize, int(this->heapSizeZ)); zi++) {
+				for (int xi = x0; xi < std::min(x0 + TiledHeightGrid::tileSize, int(this->heapSizeX)); xi++) {
+					reclaimBaseColumns[tile[TiledHeightGrid::getCellIndex(xi, zi)]].push_back(xi + zi * int(this->heapSizeX));
+				}
+			}
 		}
 	}
+}
+
+template<typename Parameters>
+int blendingsimulator::BlendingSimulatorFast<Parameters>::getDepositIndex(ReclaimState& state, int baseIndex, int height)
+{
+	const int reclaimIndex = getReclaimIndex(state, baseIndex, height);
+	if (isReclaimRing()) {
+		return reclaimIndex;
+	}
 
-	reclaimParameters[reclaimIndex].push(parameters);
+	// Slices already passed by the reclaimer are gone, late material is reclaimed with the first slice still open
+	const int firstOpenSlice = int(std::min(state.reclaimerPos / realWorldSizeFactor, double(sliceCount - 1)));
+	return std::max(reclaimIndex, firstOpenSlice);
 }
 
 template<typename Parameters>
-void blendingsimulator::BlendingSimulatorFast<Parameters>::updateHeapMap()
+int blendingsimulator::BlendingSimulatorFast<Parameters>::getReclaimIndex(ReclaimState& state, int baseIndex, int height)
 {
-	// Either way this is cache inefficient
-	for (int z = 0; z < this->heapSizeZ; z++) {
-		for (int x = 0; x < this->heapSizeX; x++) {
-			this->heapMap[z * this->heapSizeX + x] = stackedHeights[x + 1][z + 1] > 0 ? float(stackedHeights[x + 1][z + 1]) * realWorldSizeFactor : 0.0f;
+	const int n = sliceCount;
+	const size_t level = size_t(std::max(0, height));
+
+	while (state.heightOffsets.size() <= level) {
+		const int offset = getReclaimHeightOffset(int(state.heightOffsets.size()), state.tanAngle);
+
+		// Circular offsets wrap around so that a single correction of the sum suffices
+		state.heightOffsets.push_back(this->simulationParameters.circular ? offset % n : offset);
+	}
+
+	if (this->simulationParameters.circular) {
+		const int reclaimIndex = baseIndex - state.heightOffsets[level];
+		return reclaimIndex < 0 ? reclaimIndex + n : reclaimIndex;
+	} else {
+		const int reclaimIndex = (state.fixedIndex >= 0 ? state.fixedIndex : baseIndex) - state.heightOffsets[level];
+		return std::max(0, std::min(reclaimIndex, n - 1));
+	}
+}
+
+template<typename Parameters>
+bool blendingsimulator::BlendingSimulatorFast<Parameters>::isReclaimRing() const
+{
+	return this->simulationParameters.geometricReclaim && this->simulationParameters.circular;
+}
+
+// Lowers every column to the lowest cell whose slice was drained in [startPos, endPos)
+// Material above that cell is removed from the heights even if it was deposited after the reclaimer passed its slice,
+// it stays in its slice and is collected on the next pass of the reclaimer
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorFast<Parameters>::cutReclaimedHeights(ReclaimState& state, int64_t startPos, int64_t endPos)
+{
+	const int n = sliceCount;
+	const bool circular = this->simulationParameters.circular;
+	const int64_t count = std::min<int64_t>(endPos - startPos, n);
+
+	auto drained = [&](int slice) {
+		if (circular) {
+			return (slice - startPos % n + n) % n < count;
+		}
+		return slice < endPos;
+	};
+
+	auto cutColumn = [&](int xi, int zi, int baseIndex) {
+		const int height = stackedHeights.get(xi, zi);
+		for (int h = 0; h < height; h++) {
+			if (drained(getReclaimIndex(state, baseIndex, h))) {
+				stackedHeights.set(xi, zi, h);
+				if (this->simulationParameters.acceleratedDescent) {
+					invalidateDescent(xi, zi);
+				}
+				if (this->simulationParameters.trackLayers) {
+					cutLayers(xi, zi, h);
+				}
+				return;
+			}
+		}
+	};
+
+	// Columns whose top reaches back into the drained range lie up to the largest height offset ahead of it
+	const int64_t lookAhead = maxHeight > 0 ? int64_t(getReclaimHeightOffset(maxHeight - 1, state.tanAngle)) + 1 : 0;
+	const int64_t last = std::min<int64_t>(startPos + count + lookAhead, startPos + n);
+
+	if (circular) {
+		bucketReclaimBaseColumns();
+
+		for (int64_t k = startPos; k < last; k++) {
+			const int baseIndex = int(k % n);
+			for (const int32_t column : reclaimBaseColumns[baseIndex]) {
+				cutColumn(column % int(this->heapSizeX), column / int(this->heapSizeX), baseIndex);
+			}
+		}
+	} else {
+		for (int64_t xi = startPos; xi < std::min<int64_t>(last, n); xi++) {
+			for (int zi = 0; zi < int(this->heapSizeZ); zi++) {
+				cutColumn(int(xi), zi, int(xi));
+			}
 		}
 	}
 }
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulatorFast<Parameters>::updateHeapMap()
+{
+	stackedHeights.copyTo(this->heapMap, realWorldSizeFactor);
+}
@@ -0,0 +1,156 @@
+#ifndef BLENDINGSIMULATOR_TILEDHEIGHTGRID_H
+#define BLENDINGSIMULATOR_TILEDHEIGHTGRID_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace blendingsimulator
+{
+// Integer height grid split into square tiles which are allocated on first write
+// Untouched tiles read as ground level and heights are stored in 16 bit until a tile exceeds that range
+class TiledHeightGrid
+{
+	public:
+		static constexpr const int tileShift = 6;
+		static constexpr const int tileSize = 1 << tileShift;
+		static constexpr const int tileMask = tileSize - 1;
+		static constexpr const int tileCellCount = tileSize * tileSize;
+
+		TiledHeightGrid()
+			: TiledHeightGrid(0, 0)
+		{
+		}
+
+		TiledHeightGrid(unsigned int sizeX, unsigned int sizeZ)
+			: sizeX(sizeX)
+			, sizeZ(sizeZ)
+			, tilesX((sizeX + tileMask) >> tileShift)
+			, tilesZ((sizeZ + tileMask) >> tileShift)
+			, tiles(size_t(tilesX) * tilesZ)
+		{
+		}
+
+		// Cells outside of the grid act as infinitely high walls
+		int get(int x, int z) const
+		{
+			if (static_cast<unsigned int>(x) >= sizeX || static_cast<unsigned int>(z) >= sizeZ) {
+				return std::numeric_limits<int>::max();
+			}
+
+			const Tile* tile = tiles[getTileIndex(x, z)].get();
+			if (!tile) {
+				return 0;
+			}
+
+			const int cell = getCellIndex(x, z);
+			return tile->wide ? tile->wide[cell] : tile->compact[cell];
+		}
+
+		void set(int x, int z, int height)
+		{
+			std::unique_ptr<Tile>& tile = tiles[getTileIndex(x, z)];
+			if (!tile) {
+				tile.reset(new Tile());
+				tile->compact.reset(new uint16_t[tileCellCount]());
+			}
+
+			const int cell = getCellIndex(x, z);
+			if (!tile->wide) {
+				if (height >= 0 && height <= std::numeric_limits<uint16_t>::max()) {
+					tile->compact[cell] = static_cast<uint16_t>(height);
+					return;
+				}
+
+				tile->wide.reset(new int32_t[tileCellCount]);
+				std::copy(tile->compact.get(), tile->compact.get() + tileCellCount, tile->wide.get());
+				tile->compact.reset();
+			}
+			tile->wide[cell] = height;
+		}
+
+		// Resets all heights to ground level while keeping tiles allocated for reuse
+		void clear()
+		{
+			for (std::unique_ptr<Tile>& tile : tiles) {
+				if (!tile) {
+					continue;
+				}
+
+				if (tile->wide) {
+					std::fill(tile->wide.get(), tile->wide.get() + tileCellCount, 0);
+				} else {
+					std::fill(tile->compact.get(), tile->compact.get() + tileCellCount, 0);
+				}
+			}
+		}
+
+		// Writes heights scaled by factor into a dense z major array of sizeX * sizeZ
+		void copyTo(float* target, float factor) const
+		{
+			for (unsigned int z = 0; z < sizeZ; z++) {
+				for (unsigned int tx = 0; tx < tilesX; tx++) {
+					const Tile* tile = tiles[(z >> tileShift) * tilesX + tx].get();
+					const unsigned int xBegin = tx << tileShift;
+					const unsigned int xEnd = std::min(sizeX, xBegin + tileSize);
+					float* row = target + size_t(z) * sizeX;
+
+					if (!tile) {
+						std::fill(row + xBegin, row + xEnd, 0.0f);
+						continue;
+					}
+
+					for (unsigned int x = xBegin; x < xEnd; x++) {
+						const int cell = getCellIndex(x, z);
+						const int h = tile->wide ? tile->wide[cell] : tile->compact[cell];
+						row[x] = h > 0 ? float(h) * factor : 0.0f;
+					}
+				}
+			}
+		}
+
+		size_t getTileIndex(int x, int z) const
+		{
+			return size_t(z >> tileShift) * tilesX + (x >> tileShift);
+		}
+
+		static int getCellIndex(int x, int z)
+		{
+			return ((z & tileMask) << tileShift) | (x & tileMask);
+		}
+
+		size_t getTileCount() const
+		{
+			return tiles.size();
+		}
+
+		bool isTileAllocated(size_t tileIndex) const
+		{
+			return bool(tiles[tileIndex]);
+		}
+
+		size_t getAllocatedTileCount() const
+		{
+			return static_cast<size_t>(std::count_if(tiles.begin(), tiles.end(), [](const std::unique_ptr<Tile>& tile) {
+				return bool(tile);
+			}));
+		}
+
+	private:
+		struct Tile
+		{
+			std::unique_ptr<uint16_t[]> compact;
+			std::unique_ptr<int32_t[]> wide;
+		};
+
+		unsigned int sizeX;
+		unsigned int sizeZ;
+		unsigned int tilesX;
+		unsigned int tilesZ;
+		std::vector<std::unique_ptr<Tile>> tiles;
+};
+}
+
+#endif
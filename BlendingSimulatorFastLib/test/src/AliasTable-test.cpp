@@ -0,0 +1,42 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+#include "BlendingSimulator/detail/AliasTable.h"
+
+namespace bs = blendingsimulator;
+
+TEST(AliasTable, test_distribution)
+{
+	const std::vector<double> weights = {1.0, 0.0, 3.0, 6.0};
+	bs::AliasTable table(weights);
+	EXPECT_EQ(table.size(), 4);
+
+	bs::RandomStream random(1);
+	const int samples = 100000;
+	std::vector<int> counts(weights.size(), 0);
+	for (int i = 0; i < samples; i++) {
+		counts[table.sample(random)]++;
+	}
+
+	EXPECT_NEAR(double(counts[0]) / samples, 0.1, 0.01);
+	EXPECT_EQ(counts[1], 0);
+	EXPECT_NEAR(double(counts[2]) / samples, 0.3, 0.01);
+	EXPECT_NEAR(double(counts[3]) / samples, 0.6, 0.01);
+}
+
+TEST(AliasTable, test_single_weight)
+{
+	bs::AliasTable table({2.5});
+	bs::RandomStream random(1);
+	for (int i = 0; i < 100; i++) {
+		EXPECT_EQ(table.sample(random), 0);
+	}
+}
+
+TEST(AliasTable, test_invalid_weights)
+{
+	EXPECT_THROW(bs::AliasTable(std::vector<double>{}), std::invalid_argument);
+	EXPECT_THROW(bs::AliasTable({0.0, 0.0}), std::invalid_argument);
+	EXPECT_THROW(bs::AliasTable({1.0, -1.0}), std::invalid_argument);
+}
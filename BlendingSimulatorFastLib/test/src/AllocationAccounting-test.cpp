@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+#include "BlendingSimulator/AllocationInterposer.h"
+#include "BlendingSimulator/BlendingSimulatorFast.h"
+#include "BlendingSimulator/ParticleParameters.h"
+
+namespace bs = blendingsimulator;
+
+namespace
+{
+bs::SimulationParameters getAccountingParameters()
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 40.0f;
+	simulationParameters.heapWorldSizeZ = 10.0f;
+	simulationParameters.reclaimAngle = 45.0;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.seed = 1;
+	return simulationParameters;
+}
+
+// Chevron passes along the center line of the bed, 0.5 m³ per step leaves partial particles in the input buffer
+void stackPasses(bs::BlendingSimulatorFast<bs::AveragedParameters>& simulator, const bs::AveragedParameters& parameters, int passes)
+{
+	for (int pass = 0; pass < passes; pass++) {
+		for (int i = 0; i < 40; i++) {
+			const float x = pass % 2 == 0 ? float(i) : float(39 - i);
+			simulator.stack(x, 5.0f, parameters);
+		}
+	}
+}
+}
+
+TEST(AllocationAccounting, test_steady_state_stacking)
+{
+	for (bool acceleratedDescent : {false, true}) {
+		bs::SimulationParameters simulationParameters = getAccountingParameters();
+		simulationParameters.acceleratedDescent = acceleratedDescent;
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+		const bs::AveragedParameters parameters(0.5, {1.0, 2.0});
+
+		// Lazily created storage such as reclaim slices and descent tiles is filled while the heap spreads over the bed
+		stackPasses(simulator, parameters, 40);
+
+		bs::allocation::reset();
+		stackPasses(simulator, parameters, 10);
+
+		EXPECT_EQ(bs::allocation::getCounters(bs::allocation::Phase::Stack).count, 0u) << "acceleratedDescent " << acceleratedDescent;
+		EXPECT_EQ(bs::allocation::getCounters(bs::allocation::Phase::Fall).count, 0u) << "acceleratedDescent " << acceleratedDescent;
+	}
+}
+
+TEST(AllocationAccounting, test_steady_state_reclaim)
+{
+	bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(getAccountingParameters());
+	stackPasses(simulator, bs::AveragedParameters(0.5, {1.0, 2.0}), 10);
+
+	bs::AveragedParameters p;
+	simulator.reclaimInto(0.0f, p);
+	simulator.reclaimInto(0.5f, p);
+
+	bs::allocation::reset();
+	for (float position = 1.0f; !simulator.reclaimingFinished(); position += 0.5f) {
+		simulator.reclaimInto(position, p);
+	}
+
+	EXPECT_EQ(bs::allocation::getCounters(bs::allocation::Phase::Reclaim).count, 0u);
+}
+
+TEST(AllocationAccounting, test_phase_attribution)
+{
+	bs::SimulationParameters simulationParameters = getAccountingParameters();
+	simulationParameters.visualize = true;
+	bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+
+	bs::allocation::reset();
+	simulator.stack(10.0f, 5.0f, bs::AveragedParameters(20.0, {1.0}));
+
+	// Every particle is kept for visualization
+	const bs::allocation::Counters output = bs::allocation::getCounters(bs::allocation::Phase::Output);
+	EXPECT_GE(output.count, 20u);
+	EXPECT_GE(output.bytes, 20u * sizeof(bs::Particle<bs::AveragedParameters>));
+
+	std::stringstream report;
+	bs::allocation::writeReport(report, 20.0);
+	EXPECT_NE(report.str().find("output\t"), std::string::npos);
+}
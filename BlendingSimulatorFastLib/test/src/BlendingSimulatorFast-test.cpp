@@ -1,5 +1,11 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+
 #include "BlendingSimulator/BlendingSimulatorFast.h"
 #include "BlendingSimulator/ParticleParameters.h"
 
@@ -467,3 +473,793 @@ TEST(BlendingSimulatorFast, test_circular)
 		EXPECT_TRUE(simulator.reclaimingFinished());
 	}
 }
+
+TEST(BlendingSimulatorFast, test_stack_async)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 3.0f;
+	simulationParameters.heapWorldSizeZ = 3.0f;
+	simulationParameters.reclaimAngle = 90;
+	simulationParameters.eightLikelihood = 0.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.stackingQueueSize = 2;
+
+	{
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+
+		// More records than queue slots to exercise backpressure
+		float x = 1.0f;
+		float z = 1.0f;
+		for (int i = 0; i < 6; i++) {
+			simulator.stackAsync(x, z, {1.0, {1.0}});
+		}
+		simulator.finishStackingAsync().get();
+
+		EXPECT_FALSE(simulator.reclaimingFinished());
+		bs::AveragedParameters pOut = simulator.reclaim(1.0);
+		EXPECT_NEAR(pOut.getVolume(), 1, 1e-10);
+
+		EXPECT_FALSE(simulator.reclaimingFinished());
+		bs::AveragedParameters pOut2 = simulator.reclaim(2.0);
+		EXPECT_NEAR(pOut2.getVolume(), 4, 1e-10);
+
+		EXPECT_FALSE(simulator.reclaimingFinished());
+		bs::AveragedParameters pOut3 = simulator.reclaim(3.0);
+		EXPECT_NEAR(pOut3.getVolume(), 1, 1e-10);
+
+		EXPECT_TRUE(simulator.reclaimingFinished());
+	}
+}
+
+TEST(BlendingSimulatorFast, test_stack_along)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 10.0f;
+	simulationParameters.heapWorldSizeZ = 1.0f;
+	simulationParameters.reclaimAngle = 90;
+	simulationParameters.eightLikelihood = 0.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+
+	for (bool async : {false, true}) {
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+
+		// One particle at the center of each cell along the bed, split into two segments continuing each other
+		if (async) {
+			simulator.stackAlongAsync(-0.5f, 0.5f, 4.5f, 0.5f, {5.0, {1.0}});
+			simulator.stackAlongAsync(4.5f, 0.5f, 9.5f, 0.5f, {5.0, {2.0}});
+			simulator.finishStackingAsync().get();
+		} else {
+			simulator.stackAlong(-0.5f, 0.5f, 4.5f, 0.5f, {5.0, {1.0}});
+			simulator.stackAlong(4.5f, 0.5f, 9.5f, 0.5f, {5.0, {2.0}});
+		}
+
+		for (int i = 0; i < 10; i++) {
+			EXPECT_FALSE(simulator.reclaimingFinished());
+			bs::AveragedParameters pOut = simulator.reclaim(float(i + 1));
+			EXPECT_NEAR(pOut.getVolume(), 1, 1e-10) << "async " << async << " position " << i;
+			EXPECT_NEAR(pOut.getValue(0), i < 5 ? 1.0 : 2.0, 1e-10) << "async " << async << " position " << i;
+		}
+		EXPECT_TRUE(simulator.reclaimingFinished());
+	}
+}
+
+namespace
+{
+// Rejects particles on the negative X side to make the stacking worker fail
+class RejectingSimulator : public bs::BlendingSimulatorFast<bs::AveragedParameters>
+{
+	public:
+		explicit RejectingSimulator(bs::SimulationParameters simulationParameters)
+			: bs::BlendingSimulatorFast<bs::AveragedParameters>(simulationParameters)
+		{
+		}
+
+		~RejectingSimulator() override
+		{
+			this->stopStackingWorker();
+		}
+
+	protected:
+		void stackSingle(float x, float z, const bs::AveragedParameters& parameters) override
+		{
+			if (x < 0.0f) {
+				throw std::runtime_error("rejected particle");
+			}
+			bs::BlendingSimulatorFast<bs::AveragedParameters>::stackSingle(x, z, parameters);
+		}
+};
+}
+
+TEST(BlendingSimulatorFast, test_stack_async_failure)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 10.0f;
+	simulationParameters.heapWorldSizeZ = 1.0f;
+	simulationParameters.reclaimAngle = 90;
+	simulationParameters.eightLikelihood = 0.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+
+	RejectingSimulator simulator(simulationParameters);
+	simulator.stackAsync(1.5f, 0.5f, {1.0, {1.0}});
+	simulator.stackAsync(-1.0f, 0.5f, {1.0, {1.0}});
+
+	// Later input is refused as soon as the worker failed instead of being dropped silently
+	for (int i = 0; i < 1000 && !simulator.hasStackingFailed(); i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	EXPECT_TRUE(simulator.hasStackingFailed());
+	EXPECT_THROW(simulator.stackAsync(2.5f, 0.5f, {1.0, {1.0}}), std::runtime_error);
+	EXPECT_THROW(simulator.finishStackingAsync().get(), std::runtime_error);
+
+	// The failure is reported once, stacking continues afterwards
+	EXPECT_FALSE(simulator.hasStackingFailed());
+	simulator.stackAsync(3.5f, 0.5f, {1.0, {1.0}});
+	simulator.finishStackingAsync().get();
+
+	// Only the rejected particle is missing
+	EXPECT_NEAR(simulator.reclaim(10.0f).getVolume(), 2, 1e-10);
+	EXPECT_TRUE(simulator.reclaimingFinished());
+}
+
+TEST(BlendingSimulatorFast, test_discharge_footprint)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 40.0f;
+	simulationParameters.heapWorldSizeZ = 40.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.seed = 1;
+
+	// Maximum height and amount of covered cells of a heap discharged at a single position
+	auto stackHeap = [](const bs::SimulationParameters& parameters, float& maxHeight, int& coveredCells, int& coveredRows) {
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(parameters);
+		simulator.stack(20.0f, 20.0f, {400.0, {1.0}});
+
+		const float* heapMap = simulator.getHeapMap();
+		maxHeight = 0.0f;
+		coveredCells = 0;
+		coveredRows = 0;
+		for (unsigned int z = 0; z < 40; z++) {
+			bool covered = false;
+			for (unsigned int x = 0; x < 40; x++) {
+				maxHeight = std::max(maxHeight, heapMap[z * 40 + x]);
+				if (heapMap[z * 40 + x] > 0.0f) {
+					coveredCells++;
+					covered = true;
+				}
+			}
+			coveredRows += covered ? 1 : 0;
+		}
+	};
+
+	float pointHeight;
+	int pointCells;
+	int pointRows;
+	stackHeap(simulationParameters, pointHeight, pointCells, pointRows);
+
+	simulationParameters.dischargeFootprint = bs::DischargeFootprint::Gaussian;
+	simulationParameters.dischargeSizeX = 4.0f;
+	simulationParameters.dischargeSizeZ = 4.0f;
+	float gaussianHeight;
+	int gaussianCells;
+	int gaussianRows;
+	stackHeap(simulationParameters, gaussianHeight, gaussianCells, gaussianRows);
+	EXPECT_LT(gaussianHeight, pointHeight);
+	EXPECT_GT(gaussianCells, pointCells);
+
+	// Belt wide strip across the bed forms a ridge instead of a cone
+	simulationParameters.dischargeFootprint = bs::DischargeFootprint::Strip;
+	simulationParameters.dischargeSizeX = 1.0f;
+	simulationParameters.dischargeSizeZ = 30.0f;
+	float stripHeight;
+	int stripCells;
+	int stripRows;
+	stackHeap(simulationParameters, stripHeight, stripCells, stripRows);
+	EXPECT_LT(stripHeight, pointHeight);
+	EXPECT_GE(stripRows, 30);
+	EXPECT_GT(stripRows, pointRows);
+
+	simulationParameters.dischargeSizeZ = 0.0f;
+	EXPECT_THROW(bs::BlendingSimulatorFast<bs::AveragedParameters>{simulationParameters}, std::invalid_argument);
+}
+
+TEST(BlendingSimulatorFast, test_stack_composition)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 3.0f;
+	simulationParameters.heapWorldSizeZ = 1.0f;
+	simulationParameters.reclaimAngle = 90;
+	simulationParameters.eightLikelihood = 0.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+
+	{
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+
+		// Remainder of the first input is completed by the start of the second input
+		simulator.stack(0.0f, 0.0f, {1.5, {1.0}});
+		simulator.stack(2.0f, 0.0f, {1.5, {0.0}});
+		simulator.finishStacking();
+
+		bs::AveragedParameters pOut;
+		simulator.reclaimInto(1.0, pOut);
+		EXPECT_NEAR(pOut.getVolume(), 1, 1e-10);
+		EXPECT_NEAR(pOut.getValue(0), 1.0, 1e-10);
+
+		simulator.reclaimInto(2.0, pOut);
+		EXPECT_NEAR(pOut.getVolume(), 1, 1e-10);
+		EXPECT_NEAR(pOut.getValue(0), 0.0, 1e-10);
+
+		simulator.reclaimInto(3.0, pOut);
+		EXPECT_NEAR(pOut.getVolume(), 1, 1e-10);
+		EXPECT_NEAR(pOut.getValue(0), 0.5, 1e-10);
+
+		EXPECT_TRUE(simulator.reclaimingFinished());
+	}
+}
+
+TEST(BlendingSimulatorFast, test_track_layers)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 1.0f;
+	simulationParameters.heapWorldSizeZ = 1.0f;
+	simulationParameters.reclaimAngle = 90;
+	simulationParameters.eightLikelihood = 0.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.trackLayers = true;
+
+	{
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+
+		// Identical consecutive inputs are merged into one run
+		simulator.stack(0.0f, 0.0f, {2.0, {1.0}});
+		simulator.stack(0.0f, 0.0f, {1.0, {0.0}});
+		simulator.stack(0.0f, 0.0f, {1.0, {0.0}});
+		simulator.finishStacking();
+
+		const auto& layers = simulator.getColumnLayers(0, 0);
+		ASSERT_EQ(layers.size(), 2);
+		EXPECT_EQ(layers[0].begin, 0);
+		EXPECT_EQ(layers[0].end, 2);
+		EXPECT_EQ(layers[1].begin, 2);
+		EXPECT_EQ(layers[1].end, 4);
+		EXPECT_NEAR(simulator.getLayerParameters(layers[0].parameterId).getValue(0), 1.0, 1e-10);
+		EXPECT_NEAR(simulator.getLayerParameters(layers[1].parameterId).getValue(0), 0.0, 1e-10);
+
+		bs::BlendingSimulatorFast<bs::AveragedParameters>::CrossSection crossSection;
+		simulator.getCrossSection(0.0f, crossSection);
+		EXPECT_EQ(crossSection.width, 1);
+		EXPECT_EQ(crossSection.height, 4);
+		EXPECT_EQ(crossSection.parameterIds, std::vector<int>({0, 0, 1, 1}));
+
+		simulator.clear();
+		EXPECT_TRUE(simulator.getColumnLayers(0, 0).empty());
+	}
+}
+
+TEST(BlendingSimulatorFast, test_reclaim_layers)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 3.0f;
+	simulationParameters.heapWorldSizeZ = 1.0f;
+	simulationParameters.reclaimAngle = 90;
+	simulationParameters.eightLikelihood = 0.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.trackLayers = true;
+
+	{
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+
+		simulator.stack(0.0f, 0.0f, {1.0, {0.0}});
+		simulator.stack(1.0f, 0.0f, {1.0, {0.0}});
+		simulator.stack(2.0f, 0.0f, {1.0, {0.0}});
+		simulator.stack(2.0f, 0.0f, {1.0, {1.0}});
+		simulator.finishStacking();
+
+		std::vector<bs::AveragedParameters> slices;
+		simulator.reclaimLayers(90.0f, slices);
+		ASSERT_EQ(slices.size(), 3);
+		EXPECT_NEAR(slices[0].getVolume(), 1.0, 1e-10);
+		EXPECT_NEAR(slices[1].getVolume(), 1.0, 1e-10);
+		EXPECT_NEAR(slices[2].getVolume(), 2.0, 1e-10);
+		EXPECT_NEAR(slices[2].getValue(0), 0.5, 1e-10);
+
+		// Upper particle of the last column is reached one slice earlier
+		simulator.reclaimLayers(45.0f, slices);
+		EXPECT_NEAR(slices[0].getVolume(), 1.0, 1e-10);
+		EXPECT_NEAR(slices[1].getVolume(), 2.0, 1e-10);
+		EXPECT_NEAR(slices[1].getValue(0), 0.5, 1e-10);
+		EXPECT_NEAR(slices[2].getVolume(), 1.0, 1e-10);
+		EXPECT_NEAR(slices[2].getValue(0), 0.0, 1e-10);
+
+		// Layers are not consumed
+		bs::AveragedParameters pOut;
+		simulator.reclaimInto(3.0, pOut);
+		EXPECT_NEAR(pOut.getVolume(), 4.0, 1e-10);
+	}
+}
+
+TEST(BlendingSimulatorFast, test_accelerated_descent)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 3.0f;
+	simulationParameters.heapWorldSizeZ = 3.0f;
+	simulationParameters.reclaimAngle = 90;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.acceleratedDescent = true;
+
+	{
+		// Four directions only fill the center and its direct neighbours before growing in the center
+		simulationParameters.eightLikelihood = 0.0f;
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+		simulator.stack(1.0f, 1.0f, {6.0, {1.0}});
+		simulator.finishStacking();
+
+		const std::vector<float> expected = {
+			0.0f, 1.0f, 0.0f,
+			1.0f, 2.0f, 1.0f,
+			0.0f, 1.0f, 0.0f
+		};
+		const float* heapMap = simulator.getHeapMap();
+		for (unsigned int i = 0; i < expected.size(); i++) {
+			EXPECT_NEAR(heapMap[i], expected[i], 1e-10) << "cell " << i;
+		}
+	}
+
+	{
+		// Eight directions fill the whole bed evenly
+		simulationParameters.eightLikelihood = 1.0f;
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+		simulator.stack(1.0f, 1.0f, {9.0, {1.0}});
+		simulator.finishStacking();
+
+		const float* heapMap = simulator.getHeapMap();
+		for (unsigned int i = 0; i < 9; i++) {
+			EXPECT_NEAR(heapMap[i], 1.0f, 1e-10) << "cell " << i;
+		}
+	}
+}
+
+TEST(BlendingSimulatorFast, test_accelerated_descent_ramp)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 30.0f;
+	simulationParameters.heapWorldSizeZ = 1.0f;
+	simulationParameters.reclaimAngle = 90;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+
+	std::vector<float> ramp(30);
+	for (int x = 0; x < 30; x++) {
+		ramp[x] = float(x);
+	}
+
+	auto run = [&](bool acceleratedDescent, uint64_t& steps) {
+		simulationParameters.acceleratedDescent = acceleratedDescent;
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+		simulator.loadInitialHeightmap(ramp.data());
+		for (int i = 0; i < 300; i++) {
+			simulator.stack(29.0f, 0.0f, {1.0, {double(i)}});
+		}
+		simulator.finishStacking();
+		steps = simulator.getDescentStepCount();
+
+		const float* heapMap = simulator.getHeapMap();
+		return std::vector<float>(heapMap, heapMap + 30);
+	};
+
+	// Every step down the narrow ramp is free of draws, the cached descent takes the same steps
+	for (float eightLikelihood : {0.0f, 0.87f, 1.0f}) {
+		simulationParameters.eightLikelihood = eightLikelihood;
+		uint64_t acceleratedSteps = 0;
+		uint64_t steps = 0;
+		EXPECT_EQ(run(true, acceleratedSteps), run(false, steps)) << "eightLikelihood " << eightLikelihood;
+		EXPECT_EQ(acceleratedSteps, steps) << "eightLikelihood " << eightLikelihood;
+		EXPECT_GT(steps, 300u) << "eightLikelihood " << eightLikelihood;
+	}
+}
+
+TEST(BlendingSimulatorFast, test_seed)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 30.0f;
+	simulationParameters.heapWorldSizeZ = 30.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.seed = 1234;
+	simulationParameters.stackingQueueSize = 4;
+
+	auto run = [](const bs::SimulationParameters& parameters, bool async) {
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(parameters);
+		for (int i = 0; i < 20; i++) {
+			if (async) {
+				simulator.stackAsync(15.0f, 15.0f, {50.0, {double(i)}});
+			} else {
+				simulator.stack(15.0f, 15.0f, {50.0, {double(i)}});
+			}
+		}
+		if (async) {
+			simulator.finishStackingAsync().get();
+		} else {
+			simulator.finishStacking();
+		}
+
+		const std::pair<unsigned int, unsigned int> heapMapSize = simulator.getHeapMapSize();
+		const float* heapMap = simulator.getHeapMap();
+		return std::vector<float>(heapMap, heapMap + heapMapSize.first * heapMapSize.second);
+	};
+
+	// Identical seeds give identical results independent of the stacking thread
+	const std::vector<float> reference = run(simulationParameters, false);
+	EXPECT_EQ(run(simulationParameters, false), reference);
+	EXPECT_EQ(run(simulationParameters, true), reference);
+
+	simulationParameters.randomStream = 1;
+	EXPECT_NE(run(simulationParameters, false), reference);
+}
+
+TEST(BlendingSimulatorFast, test_clear_reuse)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 3.0f;
+	simulationParameters.heapWorldSizeZ = 1.0f;
+	simulationParameters.reclaimAngle = 90;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.seed = 7;
+
+	{
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+
+		// Remainder of the first run must not leak into the second run
+		simulator.stack(1.0f, 0.0f, {1.5, {1.0}});
+		simulator.finishStacking();
+		bs::AveragedParameters pOut;
+		simulator.reclaimInto(3.0, pOut);
+		EXPECT_TRUE(simulator.reclaimingFinished());
+
+		simulator.clear();
+		EXPECT_FALSE(simulator.reclaimingFinished());
+
+		simulator.stack(1.0f, 0.0f, {1.0, {0.0}});
+		simulator.finishStacking();
+		simulator.reclaimInto(3.0, pOut);
+		EXPECT_NEAR(pOut.getVolume(), 1.0, 1e-10);
+		EXPECT_NEAR(pOut.getValue(0), 0.0, 1e-10);
+		EXPECT_TRUE(simulator.reclaimingFinished());
+	}
+}
+
+TEST(BlendingSimulatorFast, test_reclaim_angles)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 20.0f;
+	simulationParameters.heapWorldSizeZ = 10.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.seed = 42;
+
+	auto run = [](const bs::SimulationParameters& parameters, unsigned int angleIndex) {
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(parameters);
+		for (int i = 0; i < 40; i++) {
+			simulator.stack(2.0f + 0.4f * float(i), 5.0f, {5.0, {double(i)}});
+		}
+		simulator.finishStacking();
+
+		std::vector<bs::AveragedParameters> result;
+		float position = 0.0f;
+		while (!simulator.reclaimingFinished(angleIndex)) {
+			result.push_back(simulator.reclaim(angleIndex, position));
+			position += 1.0f;
+		}
+		return result;
+	};
+
+	// Every angle of a combined pass equals a separate pass with only that angle
+	const std::vector<float> angles{90.0f, 45.0f, 20.0f, 135.0f};
+	simulationParameters.reclaimAngles = angles;
+	for (unsigned int a = 0; a < angles.size(); a++) {
+		bs::SimulationParameters single = simulationParameters;
+		single.reclaimAngles.clear();
+		single.reclaimAngle = angles[a];
+		EXPECT_EQ(run(simulationParameters, a), run(single, 0));
+	}
+
+	bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+	EXPECT_EQ(simulator.getReclaimAngleCount(), angles.size());
+	EXPECT_EQ(simulator.getReclaimAngle(1), 45.0f);
+	EXPECT_THROW(simulator.getReclaimAngle(4), std::out_of_range);
+}
+
+TEST(BlendingSimulatorFast, test_deposit_log)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 20.0f;
+	simulationParameters.heapWorldSizeZ = 10.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.seed = 3;
+	simulationParameters.depositLogFile = ::testing::TempDir() + "BlendingSimulatorFast-test_deposit_log.bsdl";
+
+	std::vector<float> heights;
+	{
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+		simulator.stack(10.0f, 5.0f, {30.0, {1.0}});
+		simulator.stack(12.0f, 5.0f, {20.0, {2.0}});
+		simulator.finishStacking();
+
+		const float* heapMap = simulator.getHeapMap();
+		heights.assign(heapMap, heapMap + 20 * 10);
+	}
+
+	// Replaying the log reproduces the heap map
+	bs::DepositLogReader reader(simulationParameters.depositLogFile);
+	std::vector<float> replayed(heights.size(), 0.0f);
+	bs::DepositRecord record;
+	double volume = 0.0;
+	double weightedValue = 0.0;
+	while (reader.next(record)) {
+		const bs::DepositParameters& parameters = reader.getParameters(record.parameterId);
+		volume += parameters.volume;
+		weightedValue += parameters.volume * parameters.values[0];
+		float& h = replayed[record.z * 20 + record.x];
+		h = std::max(h, float(record.y + 1));
+	}
+	EXPECT_EQ(replayed, heights);
+	EXPECT_NEAR(volume, 50.0, 1e-10);
+	EXPECT_NEAR(weightedValue, 70.0, 1e-10);
+
+	std::remove(simulationParameters.depositLogFile.c_str());
+}
+
+TEST(BlendingSimulatorFast, test_geometric_reclaim)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 20.0f;
+	simulationParameters.heapWorldSizeZ = 10.0f;
+	simulationParameters.reclaimAngle = 45.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.seed = 5;
+	simulationParameters.geometricReclaim = true;
+
+	{
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+		for (int i = 0; i < 20; i++) {
+			simulator.stack(3.0f + 0.7f * float(i), 5.0f, {10.0, {1.0}});
+		}
+		simulator.finishStacking();
+
+		// Heights in front of the reclaimer face remain, everything behind it is gone
+		bs::AveragedParameters pOut;
+		simulator.reclaimInto(10.0f, pOut);
+		double reclaimed = pOut.getVolume();
+		const float* heapMap = simulator.getHeapMap();
+		double remaining = 0.0;
+		for (int z = 0; z < 10; z++) {
+			for (int x = 0; x < 20; x++) {
+				if (x < 10) {
+					EXPECT_EQ(heapMap[z * 20 + x], 0.0f);
+				}
+				remaining += heapMap[z * 20 + x];
+			}
+		}
+		EXPECT_NEAR(reclaimed + remaining, 200.0, 1e-10);
+
+		// Restacking behind the reclaimer fills the lowered heap again
+		simulator.stack(5.0f, 5.0f, {4.0, {2.0}});
+		simulator.finishStacking();
+		EXPECT_GT(simulator.getHeapMap()[5 * 20 + 5], 0.0f);
+	}
+
+	simulationParameters.reclaimAngle = 135.0f;
+	EXPECT_THROW(bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters), std::invalid_argument);
+}
+
+TEST(BlendingSimulatorFast, test_geometric_reclaim_circular)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 20.0f;
+	simulationParameters.heapWorldSizeZ = 20.0f;
+	simulationParameters.reclaimAngle = 45.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.circular = true;
+	simulationParameters.seed = 9;
+	simulationParameters.geometricReclaim = true;
+
+	{
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+		bs::AveragedParameters pOut;
+		float position = 0.0f;
+
+		// Several revolutions of interleaved stacking and reclaiming on one instance
+		for (int revolution = 0; revolution < 3; revolution++) {
+			simulator.stack(15.0f, 10.0f, {20.0, {double(revolution)}});
+			simulator.finishStacking();
+			EXPECT_FALSE(simulator.reclaimingFinished());
+
+			double reclaimed = 0.0;
+			while (!simulator.reclaimingFinished()) {
+				position += 1.0f;
+				simulator.reclaimInto(position, pOut);
+				reclaimed += pOut.getVolume();
+				if (pOut.getVolume() > 0.0) {
+					EXPECT_NEAR(pOut.getValue(0), double(revolution), 1e-10);
+				}
+			}
+			EXPECT_NEAR(reclaimed, 20.0, 1e-10);
+
+			const float* heapMap = simulator.getHeapMap();
+			EXPECT_EQ(*std::max_element(heapMap, heapMap + 20 * 20), 0.0f);
+		}
+		EXPECT_GT(position, 31.4f * 2.0f);
+	}
+}
+
+TEST(BlendingSimulatorFast, test_geometric_reclaim_circular_new_tiles)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 140.0f;
+	simulationParameters.heapWorldSizeZ = 140.0f;
+	simulationParameters.reclaimAngle = 45.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.circular = true;
+	simulationParameters.seed = 10;
+	simulationParameters.geometricReclaim = true;
+
+	{
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+		bs::AveragedParameters pOut;
+		float position = 0.0f;
+
+		// Each revolution stacks onto height tiles first allocated after earlier reclaims
+		const float stackerX[] = {10.0f, 130.0f, 70.0f};
+		const float stackerZ[] = {70.0f, 10.0f, 130.0f};
+		for (int revolution = 0; revolution < 3; revolution++) {
+			simulator.stack(stackerX[revolution], stackerZ[revolution], {20.0, {double(revolution)}});
+			simulator.finishStacking();
+
+			double reclaimed = 0.0;
+			while (!simulator.reclaimingFinished()) {
+				position += 1.0f;
+				simulator.reclaimInto(position, pOut);
+				reclaimed += pOut.getVolume();
+			}
+			EXPECT_NEAR(reclaimed, 20.0, 1e-10);
+
+			const float* heapMap = simulator.getHeapMap();
+			EXPECT_EQ(*std::max_element(heapMap, heapMap + 140 * 140), 0.0f) << "revolution " << revolution;
+		}
+	}
+}
+
+TEST(BlendingSimulatorFast, test_finalized_reclaim_position)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 40.0f;
+	simulationParameters.heapWorldSizeZ = 10.0f;
+	simulationParameters.reclaimAngle = 45.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.seed = 11;
+
+	auto stackAt = [](int i) {
+		return 3.0f + 0.1f * float(i);
+	};
+
+	std::vector<bs::AveragedParameters> reference;
+	{
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+		for (int i = 0; i < 300; i++) {
+			simulator.stack(stackAt(i), 5.0f, {1.0, {double(i)}});
+		}
+		simulator.finishStacking();
+		for (float position = 0.0f; !simulator.reclaimingFinished(); position += 1.0f) {
+			reference.push_back(simulator.reclaim(position));
+		}
+	}
+
+	// Rows reclaimed while the stacker moves along the bed equal the rows after stacking finished
+	bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+	std::vector<bs::AveragedParameters> streamed;
+	float position = 0.0f;
+	for (int i = 0; i < 300; i++) {
+		simulator.stack(stackAt(i), 5.0f, {1.0, {double(i)}});
+		const float finalized = simulator.finalizedReclaimPosition(stackAt(i));
+		EXPECT_LE(finalized, stackAt(i));
+		for (; position <= finalized; position += 1.0f) {
+			streamed.push_back(simulator.reclaim(position));
+		}
+	}
+	EXPECT_GT(streamed.size(), 10);
+
+	simulator.finishStacking();
+	for (; !simulator.reclaimingFinished(); position += 1.0f) {
+		streamed.push_back(simulator.reclaim(position));
+	}
+	EXPECT_EQ(streamed, reference);
+
+	simulationParameters.circular = true;
+	bs::BlendingSimulatorFast<bs::AveragedParameters> circular(simulationParameters);
+	EXPECT_THROW(circular.finalizedReclaimPosition(10.0f), std::logic_error);
+}
+
+TEST(BlendingSimulatorFast, test_finalized_reclaim_position_stationary)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 40.0f;
+	simulationParameters.heapWorldSizeZ = 10.0f;
+	simulationParameters.reclaimAngle = 45.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.seed = 11;
+
+	// The pile keeps growing in place and spreads behind previously finalized positions without losing material
+	bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+	double volume = 0.0;
+	float position = 0.0f;
+	for (int i = 0; i < 400; i++) {
+		simulator.stack(20.0f, 5.0f, {1.0, {double(i)}});
+		const float finalized = simulator.finalizedReclaimPosition(20.0f);
+		EXPECT_LE(finalized, 20.0f);
+		for (; position <= finalized; position += 1.0f) {
+			volume += simulator.reclaim(position).getVolume();
+		}
+	}
+	EXPECT_GT(position, 1.0f);
+
+	simulator.finishStacking();
+	for (; !simulator.reclaimingFinished(); position += 1.0f) {
+		volume += simulator.reclaim(position).getVolume();
+	}
+	EXPECT_NEAR(volume, 400.0, 1e-6);
+}
+
+TEST(BlendingSimulatorFast, test_load_initial_heightmap)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = 5.0f;
+	simulationParameters.heapWorldSizeZ = 1.0f;
+	simulationParameters.reclaimAngle = 90;
+	simulationParameters.eightLikelihood = 0.0f;
+	simulationParameters.particlesPerCubicMeter = 1.0f;
+	simulationParameters.trackLayers = true;
+
+	const float heights[] = {0.0f, 1.0f, 2.0f, 3.4f, -1.0f};
+
+	{
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+		simulator.stack(4.0f, 0.0f, {2.0, {1.0}});
+
+		const bs::AveragedParameters composition(10.0, {5.0});
+		simulator.loadInitialHeightmap(heights, &composition);
+
+		const float* heapMap = simulator.getHeapMap();
+		EXPECT_FLOAT_EQ(heapMap[0], 0.0f);
+		EXPECT_FLOAT_EQ(heapMap[1], 1.0f);
+		EXPECT_FLOAT_EQ(heapMap[2], 2.0f);
+		EXPECT_FLOAT_EQ(heapMap[3], 3.0f);
+		EXPECT_FLOAT_EQ(heapMap[4], 0.0f);
+		EXPECT_EQ(simulator.getColumnLayers(3, 0).size(), 1u);
+
+		// Previously stacked material is replaced
+		const double expectedVolumes[] = {0.0, 1.0, 2.0, 3.0, 0.0};
+		for (int i = 0; i < 5; i++) {
+			bs::AveragedParameters pOut = simulator.reclaim(float(i + 1));
+			EXPECT_NEAR(pOut.getVolume(), expectedVolumes[i], 1e-10) << "position " << i;
+			if (expectedVolumes[i] > 0.0) {
+				EXPECT_NEAR(pOut.getValue(0), 5.0, 1e-10) << "position " << i;
+			}
+		}
+		EXPECT_TRUE(simulator.reclaimingFinished());
+	}
+
+	{
+		simulationParameters.acceleratedDescent = true;
+		bs::BlendingSimulatorFast<bs::AveragedParameters> simulator(simulationParameters);
+
+		// Inert material only shapes the surface, the particle rolls down to the lowest cell
+		simulator.loadInitialHeightmap(heights);
+		simulator.stack(2.0f, 0.0f, {1.0, {1.0}});
+
+		EXPECT_FLOAT_EQ(simulator.getHeapMap()[0], 1.0f);
+		bs::AveragedParameters pOut = simulator.reclaim(5.0f);
+		EXPECT_NEAR(pOut.getVolume(), 1.0, 1e-10);
+		EXPECT_NEAR(pOut.getValue(0), 1.0, 1e-10);
+	}
+
+	EXPECT_THROW(
+		bs::BlendingSimulatorFast<bs::AveragedParameters>(simulationParameters).loadInitialHeightmap(nullptr),
+		std::invalid_argument
+	);
+}
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include <limits>
+
+#include "BlendingSimulator/detail/TiledHeightGrid.h"
+
+namespace bs = blendingsimulator;
+
+TEST(TiledHeightGrid, test_untouched)
+{
+	bs::TiledHeightGrid grid(1000, 300);
+	EXPECT_EQ(grid.getTileCount(), 16 * 5);
+	EXPECT_EQ(grid.getAllocatedTileCount(), 0);
+	EXPECT_EQ(grid.get(0, 0), 0);
+	EXPECT_EQ(grid.get(999, 299), 0);
+	EXPECT_EQ(grid.get(-1, 0), std::numeric_limits<int>::max());
+	EXPECT_EQ(grid.get(0, 300), std::numeric_limits<int>::max());
+	EXPECT_EQ(grid.get(1000, 0), std::numeric_limits<int>::max());
+}
+
+TEST(TiledHeightGrid, test_set)
+{
+	bs::TiledHeightGrid grid(1000, 300);
+	grid.set(70, 10, 5);
+	grid.set(71, 10, 100000);
+	grid.set(999, 299, 1);
+
+	EXPECT_EQ(grid.getAllocatedTileCount(), 2);
+	EXPECT_TRUE(grid.isTileAllocated(grid.getTileIndex(70, 10)));
+	EXPECT_FALSE(grid.isTileAllocated(grid.getTileIndex(10, 10)));
+	EXPECT_EQ(grid.get(70, 10), 5);
+	EXPECT_EQ(grid.get(71, 10), 100000);
+	EXPECT_EQ(grid.get(72, 10), 0);
+	EXPECT_EQ(grid.get(999, 299), 1);
+
+	std::vector<float> dense(1000 * 300, -1.0f);
+	grid.copyTo(dense.data(), 0.5f);
+	EXPECT_FLOAT_EQ(dense[10 * 1000 + 70], 2.5f);
+	EXPECT_FLOAT_EQ(dense[10 * 1000 + 71], 50000.0f);
+	EXPECT_FLOAT_EQ(dense[0], 0.0f);
+	EXPECT_FLOAT_EQ(dense[299 * 1000 + 999], 0.5f);
+
+	grid.clear();
+	EXPECT_EQ(grid.getAllocatedTileCount(), 2);
+	EXPECT_EQ(grid.get(70, 10), 0);
+	EXPECT_EQ(grid.get(71, 10), 0);
+}
@@ -0,0 +1,145 @@
+#ifndef BLENDINGSIMULATOR_ALLOCATIONACCOUNTING_H
+#define BLENDINGSIMULATOR_ALLOCATIONACCOUNTING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// BLENDINGSIMULATOR_ALLOCATION_PHASE(Stack) attributes heap allocations of the enclosing scope on the calling thread to a phase
+// Accounting is opt-in per executable: define BLENDINGSIMULATOR_ALLOCATION_ACCOUNTING for all of its translation units and
+// include AllocationInterposer.h in exactly one of them, otherwise the macro expands to nothing
+#ifdef BLENDINGSIMULATOR_ALLOCATION_ACCOUNTING
+#define BLENDINGSIMULATOR_ALLOCATION_CONCAT_(a, b) a##b
+#define BLENDINGSIMULATOR_ALLOCATION_CONCAT(a, b) BLENDINGSIMULATOR_ALLOCATION_CONCAT_(a, b)
+#define BLENDINGSIMULATOR_ALLOCATION_PHASE(phase) \
+	const blendingsimulator::allocation::PhaseScope BLENDINGSIMULATOR_ALLOCATION_CONCAT(allocationPhase, __LINE__)( \
+		blendingsimulator::allocation::Phase::phase \
+	)
+#else
+#define BLENDINGSIMULATOR_ALLOCATION_PHASE(phase)
+#endif
+
+namespace blendingsimulator
+{
+namespace allocation
+{
+#ifdef BLENDINGSIMULATOR_ALLOCATION_ACCOUNTING
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+enum class Phase
+{
+	Other, // Allocations outside of any instrumented phase
+	Stack, // Input buffering and bookkeeping of deposited particles
+	Fall, // Descent of particles onto the heap
+	Reclaim,
+	Output // Height maps and particles for visualization
+};
+
+constexpr size_t phaseCount = 5;
+
+inline const char* getPhaseName(Phase phase)
+{
+	switch (phase) {
+		case Phase::Other:
+			return "other";
+		case Phase::Stack:
+			return "stack";
+		case Phase::Fall:
+			return "fall";
+		case Phase::Reclaim:
+			return "reclaim";
+		case Phase::Output:
+			return "output";
+	}
+	return "unknown";
+}
+
+struct Counters
+{
+	uint64_t count = 0;
+	uint64_t bytes = 0;
+};
+
+// Everything used by the allocator has to be constant initialized and must not allocate itself
+namespace detail
+{
+inline std::atomic<uint64_t> counts[phaseCount] = {};
+inline std::atomic<uint64_t> bytes[phaseCount] = {};
+inline thread_local Phase currentPhase = Phase::Other;
+}
+
+inline void recordAllocation(size_t size)
+{
+	const auto i = static_cast<size_t>(detail::currentPhase);
+	detail::counts[i].fetch_add(1, std::memory_order_relaxed);
+	detail::bytes[i].fetch_add(size, std::memory_order_relaxed);
+}
+
+inline Counters getCounters(Phase phase)
+{
+	const auto i = static_cast<size_t>(phase);
+	Counters counters;
+	counters.count = detail::counts[i].load(std::memory_order_relaxed);
+	counters.bytes = detail::bytes[i].load(std::memory_order_relaxed);
+	return counters;
+}
+
+inline Counters getTotalCounters()
+{
+	Counters total;
+	for (size_t i = 0; i < phaseCount; i++) {
+		const Counters counters = getCounters(static_cast<Phase>(i));
+		total.count += counters.count;
+		total.bytes += counters.bytes;
+	}
+	return total;
+}
+
+inline void reset()
+{
+	for (size_t i = 0; i < phaseCount; i++) {
+		detail::counts[i].store(0, std::memory_order_relaxed);
+		detail::bytes[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+class PhaseScope
+{
+	public:
+		explicit PhaseScope(Phase phase)
+			: previous(detail::currentPhase)
+		{
+			detail::currentPhase = phase;
+		}
+
+		PhaseScope(const PhaseScope&) = delete;
+		PhaseScope& operator=(const PhaseScope&) = delete;
+
+		~PhaseScope()
+		{
+			detail::currentPhase = previous;
+		}
+
+	private:
+		const Phase previous;
+};
+
+// Tab separated allocations and bytes per phase, normalized by the amount of simulated particles
+inline void writeReport(std::ostream& out, double particles)
+{
+	out << "phase\tallocations\tbytes\tallocations_per_particle\tbytes_per_particle\n";
+	for (size_t i = 0; i < phaseCount; i++) {
+		const Counters counters = getCounters(static_cast<Phase>(i));
+		out << getPhaseName(static_cast<Phase>(i)) << "\t" << counters.count << "\t" << counters.bytes
+			<< "\t" << (particles > 0.0 ? double(counters.count) / particles : 0.0)
+			<< "\t" << (particles > 0.0 ? double(counters.bytes) / particles : 0.0) << "\n";
+	}
+}
+}
+}
+
+#endif
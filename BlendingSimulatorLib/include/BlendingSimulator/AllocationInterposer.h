@@ -0,0 +1,146 @@
+#ifndef BLENDINGSIMULATOR_ALLOCATIONINTERPOSER_H
+#define BLENDINGSIMULATOR_ALLOCATIONINTERPOSER_H
+
+// Replaces the global allocation functions to count allocations per phase of AllocationAccounting.h
+// Replacement functions are not inline, include this header in exactly one translation unit of an executable
+
+#include <cstdlib>
+#include <algorithm>
+#include <new>
+
+#include "AllocationAccounting.h"
+
+namespace blendingsimulator
+{
+namespace allocation
+{
+namespace detail
+{
+inline void* allocate(std::size_t size)
+{
+	recordAllocation(size);
+	void* p = std::malloc(size ? size : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+inline void* allocateAligned(std::size_t size, std::align_val_t alignment)
+{
+	recordAllocation(size);
+#ifdef _WIN32
+	void* p = _aligned_malloc(size ? size : 1, static_cast<std::size_t>(alignment));
+#else
+	void* p = nullptr;
+	if (posix_memalign(&p, std::max(static_cast<std::size_t>(alignment), sizeof(void*)), size ? size : 1) != 0) {
+		p = nullptr;
+	}
+#endif
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+inline void deallocateAligned(void* p) noexcept
+{
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	std::free(p);
+#endif
+}
+}
+}
+}
+
+void* operator new(std::size_t size)
+{
+	return blendingsimulator::allocation::detail::allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return blendingsimulator::allocation::detail::allocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	try {
+		return blendingsimulator::allocation::detail::allocate(size);
+	} catch (...) {
+		return nullptr;
+	}
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	try {
+		return blendingsimulator::allocation::detail::allocate(size);
+	} catch (...) {
+		return nullptr;
+	}
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	return blendingsimulator::allocation::detail::allocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return blendingsimulator::allocation::detail::allocateAligned(size, alignment);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+	blendingsimulator::allocation::detail::deallocateAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+	blendingsimulator::allocation::detail::deallocateAligned(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+	blendingsimulator::allocation::detail::deallocateAligned(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+	blendingsimulator::allocation::detail::deallocateAligned(p);
+}
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef BLENDINGSIMULATOR_BLENDINGMETRICS_H
+#define BLENDINGSIMULATOR_BLENDINGMETRICS_H
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace blendingsimulator
+{
+// Volume weighted mean and variance accumulated incrementally after West (1979)
+class WeightedStatistics
+{
+	public:
+		void push(double weight, double value)
+		{
+			if (weight <= 0.0) {
+				return;
+			}
+
+			totalWeight += weight;
+			const double delta = value - mean;
+			mean += delta * weight / totalWeight;
+			m2 += weight * delta * (value - mean);
+		}
+
+		double getWeight() const
+		{
+			return totalWeight;
+		}
+
+		double getMean() const
+		{
+			return mean;
+		}
+
+		double getVariance() const
+		{
+			return totalWeight > 0.0 ? m2 / totalWeight : 0.0;
+		}
+
+		double getStandardDeviation() const
+		{
+			return std::sqrt(getVariance());
+		}
+
+	private:
+		double totalWeight = 0.0;
+		double mean = 0.0;
+		double m2 = 0.0;
+};
+
+// Blending quality of a stockpile computed from the stacked input and reclaimed output without storing either
+template<typename Parameters>
+class BlendingMetrics
+{
+	public:
+		void pushInput(const Parameters& parameters)
+		{
+			push(parameters, input);
+		}
+
+		void pushOutput(const Parameters& parameters)
+		{
+			push(parameters, output);
+		}
+
+		unsigned int getValueCount() const
+		{
+			return static_cast<unsigned int>(input.size());
+		}
+
+		const WeightedStatistics& getInputStatistics(unsigned int i) const
+		{
+			return input[i];
+		}
+
+		const WeightedStatistics& getOutputStatistics(unsigned int i) const
+		{
+			return output[i];
+		}
+
+		// Ratio of input to output variance
+		double getVarianceReductionRatio(unsigned int i) const
+		{
+			const double outputVariance = output[i].getVariance();
+			return outputVariance > 0.0 ? input[i].getVariance() / outputVariance : std::numeric_limits<double>::infinity();
+		}
+
+		// Ratio of input to output standard deviation
+		double getHomogenizationEfficiency(unsigned int i) const
+		{
+			return std::sqrt(getVarianceReductionRatio(i));
+		}
+
+	private:
+		std::vector<WeightedStatistics> input;
+		std::vector<WeightedStatistics> output;
+
+		void push(const Parameters& parameters, std::vector<WeightedStatistics>& statistics)
+		{
+			const unsigned int valueCount = parameters.getValueCount();
+			if (valueCount > input.size()) {
+				input.resize(valueCount);
+				output.resize(valueCount);
+			}
+
+			for (unsigned int i = 0; i < valueCount; i++) {
+				statistics[i].push(parameters.getVolume(), parameters.getValue(i));
+			}
+		}
+};
+}
+
+#endif
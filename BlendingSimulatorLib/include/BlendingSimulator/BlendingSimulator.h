@@ -6,8 +6,16 @@
 #include <mutex>
 #include <map>
 #include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
 
+#include "DepositLog.h"
+#include "RandomStream.h"
+#include "AllocationAccounting.h"
 #include "SimulationParameters.h"
+#include "Tracing.h"
+#include "detail/RingBuffer.h"
 
 namespace blendingsimulator
 {
@@ -35,10 +43,46 @@ class BlendingSimulator
 
 		virtual void stack(float x, float z, const Parameters& parameters);
 
+		// Spreads the volume uniformly along the segment from (x0, z0) to (x1, z1) travelled by the stacker
+		virtual void stackAlong(float x0, float z0, float x1, float z1, const Parameters& parameters);
+
+		// Queue stacking onto a worker thread, blocks while the queue is full
+		// Must not be mixed with concurrent calls of stack() or finishStacking()
+		// Throws once a queued input failed, the error itself is reported by the next finishStackingAsync()
+		void stackAsync(float x, float z, const Parameters& parameters);
+		void stackAlongAsync(float x0, float z0, float x1, float z1, const Parameters& parameters);
+
+		// Future becomes ready when all previously queued material is stacked and finishStacking() returned
+		std::future<void> finishStackingAsync();
+
+		// Whether a queued input failed since the last finishStackingAsync() reported an error
+		bool hasStackingFailed();
+
 		virtual void clear() = 0;
 		virtual void finishStacking() = 0;
 		virtual bool reclaimingFinished() = 0;
-		virtual Parameters reclaim(float position) = 0;
+		virtual Parameters reclaim(float position);
+
+		// Same as reclaim() but reuses the storage of out
+		virtual void reclaimInto(float position, Parameters& out) = 0;
+
+		// Simulators evaluating several reclaim angles in one stacking pass give access to each of them
+		// Index 0 is the reclaimer of reclaim() and reclaimingFinished()
+		virtual unsigned int getReclaimAngleCount();
+		virtual float getReclaimAngle(unsigned int angleIndex);
+		virtual bool reclaimingFinished(unsigned int angleIndex);
+		Parameters reclaim(unsigned int angleIndex, float position);
+		virtual void reclaimInto(unsigned int angleIndex, float position, Parameters& out);
+
+		// Reclaim position up to which no material can be added anymore while the stacker stays at or beyond stackerMinX
+		// Simulators unable to tell return negative infinity so that nothing is final before finishStacking()
+		float finalizedReclaimPosition(float stackerMinX);
+		virtual float finalizedReclaimPosition(unsigned int angleIndex, float stackerMinX);
+
+		// Replaces the heap by heights in m laid out like getHeapMap(), e.g. left over from a previous cycle or scanned
+		// The material is reclaimed with the composition of composition if given and is inert otherwise
+		// Simulators unable to start from an existing heap throw std::logic_error
+		virtual void loadInitialHeightmap(const float* heights, const Parameters* composition = nullptr);
 
 	protected:
 		static constexpr const float pi = 3.141592653589793238463;
@@ -51,7 +95,26 @@ class BlendingSimulator
 		unsigned int heapSizeZ;
 		float* heapMap;
 
-		void initializeHeapMap(unsigned int pHeapSizeX, unsigned int pHeapSizeZ);
+		// Random numbers of the next particle keyed by seed, stream and particle index
+		RandomStream nextParticleRandom();
+
+		// Has to be called on clear() to restart the particle index and drop material left over from the last input
+		void resetStacking();
+
+		// Derived constructors open the log configured by depositLogFile with the size of their position unit
+		void openDepositLog(double positionScale);
+
+		// Records the final resting place of a particle if a deposit log is open, positions in multiples of the position scale
+		void logDeposit(int32_t x, int32_t y, int32_t z, const Parameters& parameters);
+
+		// Has to be called on finishStacking() so that the log is complete on disk
+		void flushDepositLog();
+
+		// Without allocate the heap map is allocated on the first call to getHeapMap()
+		void initializeHeapMap(unsigned int pHeapSizeX, unsigned int pHeapSizeZ, bool allocate = true);
+
+		// Has to be called by derived destructors as the worker calls virtual functions
+		void stopStackingWorker();
 
 		virtual void stackSingle(float x, float z, const Parameters& parameters) = 0;
 
@@ -60,7 +123,44 @@ class BlendingSimulator
 		};
 
 	private:
+		RandomStream random;
+		uint64_t particleIndex;
+
+		enum class StackingRequestType
+		{
+			Stack,
+			Finish,
+			Stop
+		};
+
+		struct StackingRequest
+		{
+			StackingRequestType type = StackingRequestType::Stack;
+			float x = 0.0f;
+			float z = 0.0f;
+			float x1 = 0.0f;
+			float z1 = 0.0f;
+			Parameters parameters;
+			std::shared_ptr<std::promise<void>> finished;
+		};
+
+		// Remainder of previous input which does not yet fill a particle
 		Parameters parameterBuffer;
+
+		// Particle handed to stackSingle(), reused for all particles cut from one input
+		Parameters particleBuffer;
+
+		std::unique_ptr<DepositLogWriter> depositLog;
+
+		// Consecutive particles mostly share their parameters which are then logged only once
+		Parameters lastLoggedParameters;
+		uint32_t nextParameterId = 0;
+
+		RingBuffer<StackingRequest> stackingQueue;
+		std::thread stackingWorker;
+		std::atomic<bool> stackingFailed;
+
+		void runStackingWorker();
 };
 }
 
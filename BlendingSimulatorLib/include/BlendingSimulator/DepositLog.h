@@ -0,0 +1,431 @@
+#ifndef BLENDINGSIMULATOR_DEPOSITLOG_H
+#define BLENDINGSIMULATOR_DEPOSITLOG_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace blendingsimulator
+{
+// Final resting place of one particle, positions are multiples of the log's position scale
+struct DepositRecord
+{
+	int32_t x = 0;
+	int32_t y = 0;
+	int32_t z = 0;
+	uint32_t parameterId = 0;
+};
+
+// Volume and averaged values of the material referenced by parameter ids
+struct DepositParameters
+{
+	double volume = 0.0;
+	std::vector<double> values;
+};
+
+// File layout, all numbers little endian:
+// "BSDL", uint32 version, float64 position scale, followed by chunks starting with a tag byte
+// 'P': varint id, float64 volume, varint value count, float64 values
+// 'B': varint record count, varint byte count, per record zigzag varint deltas of x, y, z and parameter id
+// 'R': simulator was cleared, following records belong to a new run
+namespace depositlog
+{
+static constexpr const char magic[4] = {'B', 'S', 'D', 'L'};
+static constexpr uint32_t version = 1;
+
+inline void putVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+	while (value >= 0x80) {
+		out.push_back(uint8_t(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(uint8_t(value));
+}
+
+inline uint64_t zigzag(int64_t value)
+{
+	return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value)
+{
+	return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+template<typename T>
+void putRaw(std::vector<uint8_t>& out, T value)
+{
+	uint8_t bytes[sizeof(T)];
+	std::memcpy(bytes, &value, sizeof(T));
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+}
+
+// Append-only log of deposited particles, compressed and written by a background thread
+// write() only copies the record into the current block so that the stacking thread is not slowed down by I/O
+class DepositLogWriter
+{
+	public:
+		static constexpr size_t blockSize = 4096;
+
+		DepositLogWriter(const std::string& filename, double positionScale)
+			: out(filename, std::ios::binary | std::ios::trunc)
+		{
+			if (!out) {
+				throw std::runtime_error("could not open deposit log '" + filename + "'");
+			}
+
+			std::vector<uint8_t> header(depositlog::magic, depositlog::magic + 4);
+			depositlog::putRaw(header, depositlog::version);
+			depositlog::putRaw(header, positionScale);
+			out.write(reinterpret_cast<const char*>(header.data()), std::streamsize(header.size()));
+
+			current.records.reserve(blockSize);
+			writer = std::thread(&DepositLogWriter::runWriter, this);
+		}
+
+		DepositLogWriter(const DepositLogWriter&) = delete;
+		DepositLogWriter& operator=(const DepositLogWriter&) = delete;
+
+		~DepositLogWriter()
+		{
+			try {
+				close();
+			} catch (...) {
+			}
+		}
+
+		// Definitions must precede the first record referencing them
+		void defineParameters(uint32_t id, const DepositParameters& parameters)
+		{
+			current.definitions.emplace_back(id, parameters);
+		}
+
+		void write(const DepositRecord& record)
+		{
+			written = true;
+			current.records.push_back(record);
+			if (current.records.size() >= blockSize) {
+				submit();
+			}
+		}
+
+		// Marks the start of a new run after the simulator was cleared, nothing to mark before the first record
+		void reset()
+		{
+			if (!written) {
+				return;
+			}
+
+			written = false;
+			current.reset = true;
+			submit();
+		}
+
+		// Blocks until everything written so far is on disk
+		void flush()
+		{
+			submit();
+
+			std::unique_lock<std::mutex> lock(mutex);
+			drained.wait(lock, [this] { return queue.empty() && !busy; });
+			if (failed) {
+				throw std::runtime_error("could not write deposit log");
+			}
+		}
+
+		void close()
+		{
+			if (!writer.joinable()) {
+				return;
+			}
+
+			submit();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			available.notify_one();
+			writer.join();
+			out.close();
+
+			if (failed) {
+				throw std::runtime_error("could not write deposit log");
+			}
+		}
+
+	private:
+		struct Chunk
+		{
+			std::vector<std::pair<uint32_t, DepositParameters>> definitions;
+			std::vector<DepositRecord> records;
+			bool reset = false;
+		};
+
+		std::ofstream out;
+		Chunk current;
+		bool written = false;
+
+		std::mutex mutex;
+		std::condition_variable available;
+		std::condition_variable drained;
+		std::deque<Chunk> queue;
+		std::vector<std::vector<DepositRecord>> spareBlocks;
+		bool busy = false;
+		bool stopping = false;
+		bool failed = false;
+		std::thread writer;
+
+		void submit()
+		{
+			if (current.definitions.empty() && current.records.empty() && !current.reset) {
+				return;
+			}
+
+			Chunk next;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!spareBlocks.empty()) {
+					next.records = std::move(spareBlocks.back());
+					spareBlocks.pop_back();
+				}
+				queue.push_back(std::move(current));
+			}
+			available.notify_one();
+
+			current = std::move(next);
+			current.records.reserve(blockSize);
+		}
+
+		void runWriter()
+		{
+			std::vector<uint8_t> buffer;
+			std::vector<uint8_t> block;
+
+			std::unique_lock<std::mutex> lock(mutex);
+			while (true) {
+				available.wait(lock, [this] { return !queue.empty() || stopping; });
+				if (queue.empty()) {
+					return;
+				}
+
+				Chunk chunk = std::move(queue.front());
+				queue.pop_front();
+				busy = true;
+				lock.unlock();
+
+				encode(chunk, buffer, block);
+				out.write(reinterpret_cast<const char*>(buffer.data()), std::streamsize(buffer.size()));
+				out.flush();
+
+				chunk.records.clear();
+				lock.lock();
+				if (!out) {
+					failed = true;
+				}
+				spareBlocks.push_back(std::move(chunk.records));
+				busy = false;
+				drained.notify_all();
+			}
+		}
+
+		static void encode(const Chunk& chunk, std::vector<uint8_t>& buffer, std::vector<uint8_t>& block)
+		{
+			buffer.clear();
+
+			for (const auto& definition : chunk.definitions) {
+				buffer.push_back('P');
+				depositlog::putVarint(buffer, definition.first);
+				depositlog::putRaw(buffer, definition.second.volume);
+				depositlog::putVarint(buffer, definition.second.values.size());
+				for (double value : definition.second.values) {
+					depositlog::putRaw(buffer, value);
+				}
+			}
+
+			if (!chunk.records.empty()) {
+				// Consecutive particles land close to each other and mostly share their parameters
+				block.clear();
+				DepositRecord previous;
+				for (const DepositRecord& record : chunk.records) {
+					depositlog::putVarint(block, depositlog::zigzag(int64_t(record.x) - previous.x));
+					depositlog::putVarint(block, depositlog::zigzag(int64_t(record.y) - previous.y));
+					depositlog::putVarint(block, depositlog::zigzag(int64_t(record.z) - previous.z));
+					depositlog::putVarint(block, depositlog::zigzag(int64_t(record.parameterId) - previous.parameterId));
+					previous = record;
+				}
+
+				buffer.push_back('B');
+				depositlog::putVarint(buffer, chunk.records.size());
+				depositlog::putVarint(buffer, block.size());
+				buffer.insert(buffer.end(), block.begin(), block.end());
+			}
+
+			if (chunk.reset) {
+				buffer.push_back('R');
+			}
+		}
+};
+
+// Sequential reader of deposit logs, parameter definitions become available as the records referencing them are read
+class DepositLogReader
+{
+	public:
+		explicit DepositLogReader(const std::string& filename)
+			: in(filename, std::ios::binary)
+		{
+			if (!in) {
+				throw std::runtime_error("could not open deposit log '" + filename + "'");
+			}
+
+			char fileMagic[4];
+			uint32_t fileVersion = 0;
+			if (!in.read(fileMagic, 4) || std::memcmp(fileMagic, depositlog::magic, 4) != 0) {
+				throw std::runtime_error("'" + filename + "' is not a deposit log");
+			}
+			readRaw(fileVersion);
+			if (fileVersion != depositlog::version) {
+				throw std::runtime_error("unsupported deposit log version " + std::to_string(fileVersion));
+			}
+			readRaw(positionScale);
+		}
+
+		double getPositionScale() const
+		{
+			return positionScale;
+		}
+
+		// Number of resets preceding the last record returned by next()
+		unsigned int getRun() const
+		{
+			return run;
+		}
+
+		bool next(DepositRecord& record)
+		{
+			while (blockPosition >= block.size() || remainingRecords == 0) {
+				if (!readChunk()) {
+					return false;
+				}
+			}
+
+			size_t position = blockPosition;
+			previous.x = int32_t(previous.x + depositlog::unzigzag(getVarint(block, position)));
+			previous.y = int32_t(previous.y + depositlog::unzigzag(getVarint(block, position)));
+			previous.z = int32_t(previous.z + depositlog::unzigzag(getVarint(block, position)));
+			previous.parameterId = uint32_t(previous.parameterId + depositlog::unzigzag(getVarint(block, position)));
+			blockPosition = position;
+			remainingRecords--;
+
+			record = previous;
+			return true;
+		}
+
+		const DepositParameters& getParameters(uint32_t id) const
+		{
+			if (id >= parameters.size()) {
+				throw std::out_of_range("undefined deposit log parameter id " + std::to_string(id));
+			}
+			return parameters[id];
+		}
+
+	private:
+		std::ifstream in;
+		double positionScale = 1.0;
+		unsigned int run = 0;
+		std::vector<DepositParameters> parameters;
+
+		std::vector<uint8_t> block;
+		size_t blockPosition = 0;
+		uint64_t remainingRecords = 0;
+		DepositRecord previous;
+
+		template<typename T>
+		void readRaw(T& value)
+		{
+			if (!in.read(reinterpret_cast<char*>(&value), sizeof(T))) {
+				throw std::runtime_error("truncated deposit log");
+			}
+		}
+
+		uint64_t readVarint()
+		{
+			uint64_t value = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				const int byte = in.get();
+				if (byte == std::char_traits<char>::eof()) {
+					throw std::runtime_error("truncated deposit log");
+				}
+				value |= uint64_t(byte & 0x7f) << shift;
+				if (!(byte & 0x80)) {
+					return value;
+				}
+			}
+			throw std::runtime_error("invalid varint in deposit log");
+		}
+
+		static uint64_t getVarint(const std::vector<uint8_t>& data, size_t& position)
+		{
+			uint64_t value = 0;
+			for (int shift = 0; shift < 64 && position < data.size(); shift += 7) {
+				const uint8_t byte = data[position++];
+				value |= uint64_t(byte & 0x7f) << shift;
+				if (!(byte & 0x80)) {
+					return value;
+				}
+			}
+			throw std::runtime_error("invalid varint in deposit log block");
+		}
+
+		bool readChunk()
+		{
+			const int tag = in.get();
+			if (tag == std::char_traits<char>::eof()) {
+				return false;
+			}
+
+			switch (tag) {
+				case 'P': {
+					const uint64_t id = readVarint();
+					DepositParameters definition;
+					readRaw(definition.volume);
+					definition.values.resize(readVarint());
+					for (double& value : definition.values) {
+						readRaw(value);
+					}
+					if (parameters.size() <= id) {
+						parameters.resize(id + 1);
+					}
+					parameters[id] = std::move(definition);
+					break;
+				}
+				case 'B': {
+					remainingRecords = readVarint();
+					block.resize(readVarint());
+					if (!in.read(reinterpret_cast<char*>(block.data()), std::streamsize(block.size()))) {
+						throw std::runtime_error("truncated deposit log");
+					}
+					blockPosition = 0;
+					previous = DepositRecord();
+					break;
+				}
+				case 'R':
+					run++;
+					break;
+				default:
+					throw std::runtime_error("invalid deposit log chunk");
+			}
+
+			return true;
+		}
+};
+}
+
+#endif
@@ -56,26 +56,64 @@ class AveragedParameters
 			}
 		}
 
+		// Push otherVolume of material with the composition of other
+		void push(const AveragedParameters& other, double otherVolume)
+		{
+			if (other.values.empty()) {
+				volume += otherVolume;
+				return;
+			}
+
+			if (values.empty()) {
+				values.resize(other.values.size(), 0.0);
+			}
+
+			if (values.size() != other.values.size()) {
+				throw std::runtime_error("invalid parameter count");
+			}
+
+			const double factor = other.volume > 1e-100 ? otherVolume / other.volume : 0.0;
+			volume += otherVolume;
+			for (int i = 0; i < values.size(); i++) {
+				values[i] += other.values[i] * factor;
+			}
+		}
+
+		// Replace contents by otherVolume of material with the composition of other while reusing allocated storage
+		void assign(const AveragedParameters& other, double otherVolume)
+		{
+			volume = 0.0;
+			values.clear();
+			push(other, otherVolume);
+		}
+
 		bool contains(double otherVolume)
 		{
 			return volume >= otherVolume;
 		}
 
 		AveragedParameters pop(double otherVolume)
+		{
+			AveragedParameters result;
+			pop(otherVolume, result);
+			return result;
+		}
+
+		// Move otherVolume of material into target
+		void pop(double otherVolume, AveragedParameters& target)
 		{
 			if (volume < otherVolume) {
 				throw std::runtime_error("could not pop volume, not enough volume left");
 			}
 
-			AveragedParameters result(otherVolume, getValues());
+			target.push(*this, otherVolume);
 
 			double newVolume = volume - otherVolume;
+			const double factor = volume > 1e-100 ? newVolume / volume : 0.0;
 			for (double& value : values) {
-				value *= newVolume / volume;
+				value *= factor;
 			}
 			volume = newVolume;
-
-			return result;
 		}
 
 		double getVolume() const
@@ -83,6 +121,21 @@ class AveragedParameters
 			return volume;
 		}
 
+		bool operator==(const AveragedParameters& other) const
+		{
+			return volume == other.volume && values == other.values;
+		}
+
+		bool operator!=(const AveragedParameters& other) const
+		{
+			return !(*this == other);
+		}
+
+		unsigned int getValueCount() const
+		{
+			return static_cast<unsigned int>(values.size());
+		}
+
 		double getValue(unsigned int i) const
 		{
 			if (i < values.size() && volume > 1e-100) {
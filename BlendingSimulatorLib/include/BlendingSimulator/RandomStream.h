@@ -0,0 +1,75 @@
+#ifndef BLENDINGSIMULATOR_RANDOMSTREAM_H
+#define BLENDINGSIMULATOR_RANDOMSTREAM_H
+
+#include <cstdint>
+
+namespace blendingsimulator
+{
+// Counter based random numbers where draw n of a stream is a hash of (key, n) with the SplitMix64 finalizer
+// Streams derived by split() are independent of each other and of the order in which they are consumed
+class RandomStream
+{
+	public:
+		explicit RandomStream(uint64_t seed = 0, uint64_t stream = 0)
+			: key(mix(mix(seed) ^ (stream + golden)))
+			, counter(0)
+		{
+		}
+
+		// Stream keyed by this stream's key and id, e.g. one per particle, strip or replicate
+		RandomStream split(uint64_t id) const
+		{
+			RandomStream child;
+			child.key = mix(key ^ mix(id + golden));
+			return child;
+		}
+
+		uint64_t next()
+		{
+			return mix(key + ++counter * golden);
+		}
+
+		// Uniform in [0, 1)
+		double uniform()
+		{
+			return double(next() >> 11) * (1.0 / 9007199254740992.0);
+		}
+
+		// Uniform in [a, b)
+		float uniform(float a, float b)
+		{
+			return a + float(uniform()) * (b - a);
+		}
+
+		// Uniform integer in [0, n)
+		int uniformInt(int n)
+		{
+			return int(((next() >> 32) * uint64_t(n)) >> 32);
+		}
+
+		uint64_t getCounter() const
+		{
+			return counter;
+		}
+
+		void setCounter(uint64_t value)
+		{
+			counter = value;
+		}
+
+		static uint64_t mix(uint64_t x)
+		{
+			x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+			return x ^ (x >> 31);
+		}
+
+	private:
+		static constexpr const uint64_t golden = 0x9e3779b97f4a7c15ULL;
+
+		uint64_t key;
+		uint64_t counter;
+};
+}
+
+#endif
@@ -1,8 +1,28 @@
 #ifndef BLENDINGSIMULATOR_SYSTEMPARAMETERS_H
 #define BLENDINGSIMULATOR_SYSTEMPARAMETERS_H
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 namespace blendingsimulator
 {
+/// Collision shape of particles in detailed simulation
+enum class ParticleShape
+{
+	Box,
+	Sphere,
+	RollingSphere // Sphere with rolling resistance approximating the interlocking of angular particles
+};
+
+/// Area around the stacker position onto which particles are discharged in fast simulation
+enum class DischargeFootprint
+{
+	Point,
+	Gaussian, // Elliptic normal distribution with standard deviations dischargeSizeX and dischargeSizeZ
+	Strip // Uniform over a rectangle of dischargeSizeX by dischargeSizeZ, e.g. the width of a belt
+};
+
 struct SimulationParameters
 {
 	/* Generic */
@@ -22,23 +42,66 @@ struct SimulationParameters
 	/// Simulate a circular stockpile with the stacker moving from the center of the world
 	bool circular = false;
 
+	/// Master seed of all random numbers, equal seeds give identical results, 0 seeds from the system
+	uint64_t seed = 0;
+
+	/// Independent random stream derived from the seed, e.g. the replicate of an ensemble
+	uint64_t randomStream = 0;
+
+	/// Amount of input records stackAsync() may queue before blocking the caller
+	unsigned int stackingQueueSize = 1024;
+
+	/// File receiving the final position and parameters of every particle, empty to disable
+	std::string depositLogFile;
+
 
 	/* Fast simulation */
 
 	/// Likelihood of considering 8 instead of 4 fall directions resulting in cone like shapes instead of pyramids
 	float eightLikelihood = 0.87f;
 
+	/// Reclaim angles evaluated in the same stacking pass, reclaimAngle is used when empty
+	std::vector<float> reclaimAngles;
+
+	/// Distribution of the drop position of every particle around the stacker position
+	DischargeFootprint dischargeFootprint = DischargeFootprint::Point;
+
+	/// Extent of the discharge footprint in m along the x and z axis of the world
+	float dischargeSizeX = 1.0f;
+	float dischargeSizeZ = 1.0f;
+
 	/// Sacrifice some speed to provide visualization output
 	bool visualize = false;
 
+	/// Cache the steepest descent of every cell so that particles falling down tall piles need fewer neighbour probes and random draws
+	/// Particles still descend one cell per step, the cost per particle keeps growing with the pile height
+	bool acceleratedDescent = false;
+
+	/// Lower the heights along the reclaimer face so that stacking and reclaiming can be interleaved, slices form a ring in circular mode
+	bool geometricReclaim = false;
+
+	/// Record the material deposited in every column to allow cross sections and reclaiming at other angles
+	bool trackLayers = false;
+
 
 	/* Detailed simulation */
 
-	/// Typical bulk density of cube shaped particles in detailed simulation used for volume correction
+	/// Typical bulk density of particles in detailed simulation used for volume correction
+	/// Applies to boxes, spheres are sized for their looser packing so that heaps of all shapes fill the same volume
 	float bulkDensityFactor = 1.0f;
 
+	/// Particle shape trading realism of box shapes for cheaper sphere contacts
+	ParticleShape particleShape = ParticleShape::Box;
+
 	/// Height in m above ground from which particles are dropped
 	float dropHeight = 10.0f;
+
+	/// Number of independent physics worlds the bed is split into along its length, stepped in parallel
+	/// Moving particles are coupled across boundaries in one direction only, so piles differ slightly from a single world
+	unsigned int physicsPartitions = 1;
+
+	/// Move falling particles outside of the physics engine until they approach the heap, disabling is only meant for validation
+	bool ballisticPreIntegration = true;
 };
 }
 
@@ -0,0 +1,236 @@
+#ifndef BLENDINGSIMULATOR_TRACING_H
+#define BLENDINGSIMULATOR_TRACING_H
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// BLENDINGSIMULATOR_TRACE_SCOPE("name") records the duration of the enclosing scope on the calling thread
+// Without BLENDINGSIMULATOR_TRACING defined the macro expands to nothing, names must be string literals
+#ifdef BLENDINGSIMULATOR_TRACING
+#define BLENDINGSIMULATOR_TRACE_CONCAT_(a, b) a##b
+#define BLENDINGSIMULATOR_TRACE_CONCAT(a, b) BLENDINGSIMULATOR_TRACE_CONCAT_(a, b)
+#define BLENDINGSIMULATOR_TRACE_SCOPE(name) \
+	const blendingsimulator::tracing::Scope BLENDINGSIMULATOR_TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define BLENDINGSIMULATOR_TRACE_SCOPE(name)
+#endif
+
+namespace blendingsimulator
+{
+namespace tracing
+{
+#ifdef BLENDINGSIMULATOR_TRACING
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+struct Event
+{
+	const char* name;
+	int64_t start;
+	int64_t duration;
+};
+
+// Most recent events of one thread, older events are overwritten when full
+class ThreadBuffer
+{
+	public:
+		static constexpr size_t capacity = 1 << 16;
+
+		explicit ThreadBuffer(unsigned int threadId)
+			: threadId(threadId)
+			, events(capacity)
+			, count(0)
+		{
+		}
+
+		void push(const Event& event)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			events[count % capacity] = event;
+			count++;
+		}
+
+		unsigned int getThreadId() const
+		{
+			return threadId;
+		}
+
+		std::vector<Event> getEvents()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (count <= capacity) {
+				return std::vector<Event>(events.begin(), events.begin() + count);
+			}
+			std::vector<Event> result(events.begin() + count % capacity, events.end());
+			result.insert(result.end(), events.begin(), events.begin() + count % capacity);
+			return result;
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			count = 0;
+		}
+
+	private:
+		const unsigned int threadId;
+		std::mutex mutex;
+		std::vector<Event> events;
+		uint64_t count;
+};
+
+// Buffers outlive their threads so that events of finished workers can still be exported
+// Buffers of finished threads are handed to new threads so that short-lived workers do not add up
+class Registry
+{
+	public:
+		static Registry& get()
+		{
+			static Registry registry;
+			return registry;
+		}
+
+		std::shared_ptr<ThreadBuffer> acquireBuffer()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!releasedBuffers.empty()) {
+				std::shared_ptr<ThreadBuffer> buffer = releasedBuffers.back();
+				releasedBuffers.pop_back();
+				return buffer;
+			}
+			buffers.push_back(std::make_shared<ThreadBuffer>(static_cast<unsigned int>(buffers.size()) + 1));
+			return buffers.back();
+		}
+
+		void releaseBuffer(const std::shared_ptr<ThreadBuffer>& buffer)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			releasedBuffers.push_back(buffer);
+		}
+
+		std::vector<std::shared_ptr<ThreadBuffer>> getBuffers()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return buffers;
+		}
+
+		int64_t now() const
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+		}
+
+	private:
+		std::mutex mutex;
+		std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+		std::vector<std::shared_ptr<ThreadBuffer>> releasedBuffers;
+		const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+// Owns the buffer of the current thread and returns it to the registry when the thread exits
+class ThreadBufferLease
+{
+	public:
+		ThreadBufferLease()
+			: registry(Registry::get())
+			, buffer(registry.acquireBuffer())
+		{
+		}
+
+		ThreadBufferLease(const ThreadBufferLease&) = delete;
+		ThreadBufferLease& operator=(const ThreadBufferLease&) = delete;
+
+		~ThreadBufferLease()
+		{
+			registry.releaseBuffer(buffer);
+		}
+
+		ThreadBuffer& getBuffer() const
+		{
+			return *buffer;
+		}
+
+	private:
+		Registry& registry;
+		const std::shared_ptr<ThreadBuffer> buffer;
+};
+
+inline ThreadBuffer& getThreadBuffer()
+{
+	thread_local const ThreadBufferLease lease;
+	return lease.getBuffer();
+}
+
+class Scope
+{
+	public:
+		explicit Scope(const char* name)
+			: name(name)
+			, start(Registry::get().now())
+		{
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+		~Scope()
+		{
+			getThreadBuffer().push({name, start, Registry::get().now() - start});
+		}
+
+	private:
+		const char* name;
+		const int64_t start;
+};
+
+inline void clear()
+{
+	for (const auto& buffer : Registry::get().getBuffers()) {
+		buffer->clear();
+	}
+}
+
+// Chrome trace event JSON as understood by chrome://tracing and Perfetto, timestamps in microseconds
+inline void writeChromeTrace(std::ostream& out)
+{
+	const std::ios_base::fmtflags flags = out.flags();
+	const std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(3);
+
+	out << "{\"traceEvents\":[";
+	bool first = true;
+	for (const auto& buffer : Registry::get().getBuffers()) {
+		for (const Event& event : buffer->getEvents()) {
+			out << (first ? "\n" : ",\n");
+			first = false;
+			out << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->getThreadId()
+				<< ",\"ts\":" << double(event.start) / 1000.0 << ",\"dur\":" << double(event.duration) / 1000.0 << "}";
+		}
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+inline void writeChromeTrace(const std::string& filename)
+{
+	std::ofstream out(filename);
+	if (!out) {
+		throw std::runtime_error("could not open trace file '" + filename + "'");
+	}
+	writeChromeTrace(out);
+}
+}
+}
+
+#endif
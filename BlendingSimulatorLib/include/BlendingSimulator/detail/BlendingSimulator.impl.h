@@ -1,4 +1,8 @@
 #include <fstream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
 
 #include "BlendingSimulator/Particle.h"
 
@@ -9,12 +13,18 @@ blendingsimulator::BlendingSimulator<Parameters>::BlendingSimulator(SimulationPa
 	, heapSizeZ(0)
 	, heapMap(nullptr)
 	, paused(false)
+	, random(simulationParameters.seed ? simulationParameters.seed : (uint64_t(std::random_device()()) << 32) ^ std::random_device()(), simulationParameters.randomStream)
+	, particleIndex(0)
+	, stackingQueue(simulationParameters.stackingQueueSize)
+	, stackingFailed(false)
 {
 }
 
 template<typename Parameters>
 blendingsimulator::BlendingSimulator<Parameters>::~BlendingSimulator()
 {
+	stopStackingWorker();
+
 	if (heapMap) {
 		delete[] heapMap;
 		heapMap = nullptr;
@@ -24,6 +34,12 @@ blendingsimulator::BlendingSimulator<Parameters>::~BlendingSimulator()
 template<typename Parameters>
 float* blendingsimulator::BlendingSimulator<Parameters>::getHeapMap()
 {
+	BLENDINGSIMULATOR_ALLOCATION_PHASE(Output);
+
+	if (!heapMap) {
+		heapMap = new float[heapSizeZ * heapSizeX]();
+	}
+
 	updateHeapMap();
 
 	return this->heapMap;
@@ -62,17 +78,292 @@ bool blendingsimulator::BlendingSimulator<Parameters>::isPaused()
 template<typename Parameters>
 void blendingsimulator::BlendingSimulator<Parameters>::stack(float x, float z, const Parameters& parameters)
 {
-	float volumePerParticle = 1.0f / simulationParameters.particlesPerCubicMeter;
-	parameterBuffer.push(parameters);
+	stackAlong(x, z, x, z, parameters);
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulator<Parameters>::stackAlong(float x0, float z0, float x1, float z1, const Parameters& parameters)
+{
+	BLENDINGSIMULATOR_TRACE_SCOPE("stack");
+	BLENDINGSIMULATOR_ALLOCATION_PHASE(Stack);
+
+	const double volumePerParticle = 1.0f / simulationParameters.particlesPerCubicMeter;
+	const double volume = parameters.getVolume();
+	double remainingVolume = volume;
+
+	// Particles are dropped at the center of their share of the volume along the segment
+	const float dx = x1 - x0;
+	const float dz = z1 - z0;
+	auto stackAt = [&](double particleVolume, const Parameters& particle) {
+		const double t = volume > 1e-100 ? (volume - remainingVolume + 0.5 * particleVolume) / volume : 0.0;
+		this->stackSingle(x0 + float(t) * dx, z0 + float(t) * dz, particle);
+	};
+
+	// Complete the particle started by previous input
+	if (!parameterBuffer.empty()) {
+		const double missingVolume = volumePerParticle - parameterBuffer.getVolume();
+		if (remainingVolume < missingVolume) {
+			parameterBuffer.push(parameters);
+			return;
+		}
+
+		parameterBuffer.push(parameters, missingVolume);
+		stackAt(missingVolume, parameterBuffer);
+		parameterBuffer.clear();
+		remainingVolume -= missingVolume;
+	}
+
+	// All further particles share the composition of this input
+	if (remainingVolume >= volumePerParticle) {
+		particleBuffer.assign(parameters, volumePerParticle);
+		while (remainingVolume >= volumePerParticle) {
+			stackAt(volumePerParticle, particleBuffer);
+			remainingVolume -= volumePerParticle;
+		}
+	}
 
-	while (parameterBuffer.contains(volumePerParticle)) {
-		Parameters p = parameterBuffer.pop(volumePerParticle);
-		this->stackSingle(x, z, p);
+	if (remainingVolume > 0.0) {
+		parameterBuffer.assign(parameters, remainingVolume);
 	}
 }
 
 template<typename Parameters>
-void blendingsimulator::BlendingSimulator<Parameters>::initializeHeapMap(unsigned int pHeapSizeX, unsigned int pHeapSizeZ)
+Parameters blendingsimulator::BlendingSimulator<Parameters>::reclaim(float position)
+{
+	Parameters p;
+	reclaimInto(position, p);
+	return p;
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulator<Parameters>::stackAsync(float x, float z, const Parameters& parameters)
+{
+	stackAlongAsync(x, z, x, z, parameters);
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulator<Parameters>::stackAlongAsync(float x0, float z0, float x1, float z1, const Parameters& parameters)
+{
+	if (!stackingWorker.joinable()) {
+		stackingWorker = std::thread(&BlendingSimulator<Parameters>::runStackingWorker, this);
+	}
+
+	if (stackingFailed.load()) {
+		throw std::runtime_error("stacking failed, finishStackingAsync() reports the error");
+	}
+
+	StackingRequest request;
+	request.x = x0;
+	request.z = z0;
+	request.x1 = x1;
+	request.z1 = z1;
+	request.parameters = parameters;
+	stackingQueue.push(std::move(request));
+}
+
+template<typename Parameters>
+std::future<void> blendingsimulator::BlendingSimulator<Parameters>::finishStackingAsync()
+{
+	if (!stackingWorker.joinable()) {
+		stackingWorker = std::thread(&BlendingSimulator<Parameters>::runStackingWorker, this);
+	}
+
+	StackingRequest request;
+	request.type = StackingRequestType::Finish;
+	request.finished = std::make_shared<std::promise<void>>();
+	std::future<void> future = request.finished->get_future();
+	stackingQueue.push(std::move(request));
+
+	return future;
+}
+
+template<typename Parameters>
+bool blendingsimulator::BlendingSimulator<Parameters>::hasStackingFailed()
+{
+	return stackingFailed.load();
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulator<Parameters>::stopStackingWorker()
+{
+	if (stackingWorker.joinable()) {
+		StackingRequest request;
+		request.type = StackingRequestType::Stop;
+		stackingQueue.push(std::move(request));
+		stackingWorker.join();
+	}
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulator<Parameters>::runStackingWorker()
+{
+	// Errors are reported through the future of the next finish request
+	std::exception_ptr error;
+
+	while (true) {
+		StackingRequest request = stackingQueue.pop();
+
+		switch (request.type) {
+			case StackingRequestType::Stack:
+				if (!error) {
+					try {
+						stackAlong(request.x, request.z, request.x1, request.z1, request.parameters);
+					} catch (...) {
+						error = std::current_exception();
+						stackingFailed.store(true);
+					}
+				}
+				break;
+			case StackingRequestType::Finish:
+				if (!error) {
+					try {
+						finishStacking();
+					} catch (...) {
+						error = std::current_exception();
+					}
+				}
+
+				if (error) {
+					stackingFailed.store(false);
+					request.finished->set_exception(error);
+					error = nullptr;
+				} else {
+					request.finished->set_value();
+				}
+				break;
+			case StackingRequestType::Stop:
+				return;
+		}
+	}
+}
+
+template<typename Parameters>
+unsigned int blendingsimulator::BlendingSimulator<Parameters>::getReclaimAngleCount()
+{
+	return 1;
+}
+
+template<typename Parameters>
+float blendingsimulator::BlendingSimulator<Parameters>::getReclaimAngle(unsigned int angleIndex)
+{
+	if (angleIndex != 0) {
+		throw std::out_of_range("invalid reclaim angle index " + std::to_string(angleIndex));
+	}
+
+	return simulationParameters.reclaimAngle;
+}
+
+template<typename Parameters>
+bool blendingsimulator::BlendingSimulator<Parameters>::reclaimingFinished(unsigned int angleIndex)
+{
+	if (angleIndex != 0) {
+		throw std::out_of_range("invalid reclaim angle index " + std::to_string(angleIndex));
+	}
+
+	return reclaimingFinished();
+}
+
+template<typename Parameters>
+Parameters blendingsimulator::BlendingSimulator<Parameters>::reclaim(unsigned int angleIndex, float position)
+{
+	Parameters parameters;
+	reclaimInto(angleIndex, position, parameters);
+	return parameters;
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulator<Parameters>::reclaimInto(unsigned int angleIndex, float position, Parameters& out)
+{
+	if (angleIndex != 0) {
+		throw std::out_of_range("invalid reclaim angle index " + std::to_string(angleIndex));
+	}
+
+	reclaimInto(position, out);
+}
+
+template<typename Parameters>
+float blendingsimulator::BlendingSimulator<Parameters>::finalizedReclaimPosition(float stackerMinX)
+{
+	return finalizedReclaimPosition(0, stackerMinX);
+}
+
+template<typename Parameters>
+float blendingsimulator::BlendingSimulator<Parameters>::finalizedReclaimPosition(unsigned int angleIndex, float /*stackerMinX*/)
+{
+	if (angleIndex >= getReclaimAngleCount()) {
+		throw std::out_of_range("invalid reclaim angle index " + std::to_string(angleIndex));
+	}
+
+	// Lies before the first reclaim position so that not even the first row is taken while stacking
+	return -std::numeric_limits<float>::infinity();
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulator<Parameters>::loadInitialHeightmap(const float* /*heights*/, const Parameters* /*composition*/)
+{
+	throw std::logic_error("initial heightmaps are not supported by this simulator");
+}
+
+template<typename Parameters>
+blendingsimulator::RandomStream blendingsimulator::BlendingSimulator<Parameters>::nextParticleRandom()
+{
+	return random.split(particleIndex++);
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulator<Parameters>::resetStacking()
+{
+	particleIndex = 0;
+	parameterBuffer.clear();
+
+	if (depositLog) {
+		depositLog->reset();
+	}
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulator<Parameters>::openDepositLog(double positionScale)
+{
+	if (!simulationParameters.depositLogFile.empty()) {
+		depositLog = std::make_unique<DepositLogWriter>(simulationParameters.depositLogFile, positionScale);
+	}
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulator<Parameters>::logDeposit(int32_t x, int32_t y, int32_t z, const Parameters& parameters)
+{
+	if (!depositLog) {
+		return;
+	}
+
+	if (nextParameterId == 0 || parameters != lastLoggedParameters) {
+		DepositParameters definition;
+		definition.volume = parameters.getVolume();
+		for (unsigned int i = 0; i < parameters.getValueCount(); i++) {
+			definition.values.push_back(parameters.getValue(i));
+		}
+		depositLog->defineParameters(nextParameterId++, definition);
+		lastLoggedParameters = parameters;
+	}
+
+	DepositRecord record;
+	record.x = x;
+	record.y = y;
+	record.z = z;
+	record.parameterId = nextParameterId - 1;
+	depositLog->write(record);
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulator<Parameters>::flushDepositLog()
+{
+	if (depositLog) {
+		depositLog->flush();
+	}
+}
+
+template<typename Parameters>
+void blendingsimulator::BlendingSimulator<Parameters>::initializeHeapMap(unsigned int pHeapSizeX, unsigned int pHeapSizeZ, bool allocate)
 {
 	if (heapMap) {
 		throw std::runtime_error("invalid call to BlendingSimulatorCli::initializeHeapMap(): heap map already initialized");
@@ -81,6 +372,10 @@ void blendingsimulator::BlendingSimulator<Parameters>::initializeHeapMap(unsigne
 	heapSizeX = pHeapSizeX;
 	heapSizeZ = pHeapSizeZ;
 
+	if (!allocate) {
+		return;
+	}
+
 	heapMap = new float[pHeapSizeZ * pHeapSizeX];
 	for (int z = 0; z < pHeapSizeZ; z++) {
 		for (int x = 0; x < pHeapSizeX; x++) {
@@ -0,0 +1,63 @@
+#ifndef BLENDINGSIMULATOR_RINGBUFFER_H
+#define BLENDINGSIMULATOR_RINGBUFFER_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace blendingsimulator
+{
+// Bounded blocking queue with storage allocated once at construction
+template<typename T>
+class RingBuffer
+{
+	public:
+		explicit RingBuffer(size_t capacity)
+			: slots(std::max(size_t(1), capacity))
+			, head(0)
+			, count(0)
+		{
+		}
+
+		// Blocks while the buffer is full
+		void push(T item)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			notFull.wait(lock, [this]() { return count < slots.size(); });
+
+			slots[(head + count) % slots.size()] = std::move(item);
+			count++;
+
+			lock.unlock();
+			notEmpty.notify_one();
+		}
+
+		// Blocks while the buffer is empty
+		T pop()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			notEmpty.wait(lock, [this]() { return count > 0; });
+
+			T item = std::move(slots[head]);
+			head = (head + 1) % slots.size();
+			count--;
+
+			lock.unlock();
+			notFull.notify_one();
+
+			return item;
+		}
+
+	private:
+		std::vector<T> slots;
+		size_t head;
+		size_t count;
+
+		std::mutex mutex;
+		std::condition_variable notFull;
+		std::condition_variable notEmpty;
+};
+}
+
+#endif
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include "BlendingSimulator/BlendingMetrics.h"
+#include "BlendingSimulator/ParticleParameters.h"
+
+namespace bs = blendingsimulator;
+
+TEST(WeightedStatistics, test_unweighted)
+{
+	bs::WeightedStatistics statistics;
+	for (double value : {2.0, 4.0, 4.0, 4.0, 5.0, 5.0, 7.0, 9.0}) {
+		statistics.push(1.0, value);
+	}
+
+	EXPECT_NEAR(statistics.getWeight(), 8.0, 1e-10);
+	EXPECT_NEAR(statistics.getMean(), 5.0, 1e-10);
+	EXPECT_NEAR(statistics.getVariance(), 4.0, 1e-10);
+	EXPECT_NEAR(statistics.getStandardDeviation(), 2.0, 1e-10);
+}
+
+TEST(WeightedStatistics, test_weighted)
+{
+	bs::WeightedStatistics statistics;
+	statistics.push(3.0, 1.0);
+	statistics.push(1.0, 5.0);
+	statistics.push(0.0, 100.0); // Ignored
+
+	// Same as pushing 1, 1, 1, 5 with unit weights
+	EXPECT_NEAR(statistics.getMean(), 2.0, 1e-10);
+	EXPECT_NEAR(statistics.getVariance(), 3.0, 1e-10);
+}
+
+TEST(BlendingMetrics, test_variance_reduction)
+{
+	bs::BlendingMetrics<bs::AveragedParameters> metrics;
+	metrics.pushInput({1.0, {0.0, 1.0}});
+	metrics.pushInput({1.0, {2.0, 1.0}});
+	metrics.pushOutput({1.0, {0.5, 1.0}});
+	metrics.pushOutput({1.0, {1.5, 1.0}});
+
+	ASSERT_EQ(metrics.getValueCount(), 2);
+	EXPECT_NEAR(metrics.getInputStatistics(0).getVariance(), 1.0, 1e-10);
+	EXPECT_NEAR(metrics.getOutputStatistics(0).getVariance(), 0.25, 1e-10);
+	EXPECT_NEAR(metrics.getVarianceReductionRatio(0), 4.0, 1e-10);
+	EXPECT_NEAR(metrics.getHomogenizationEfficiency(0), 2.0, 1e-10);
+	EXPECT_TRUE(std::isinf(metrics.getVarianceReductionRatio(1)));
+}
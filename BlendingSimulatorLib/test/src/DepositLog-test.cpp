@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+#include "BlendingSimulator/DepositLog.h"
+
+namespace bs = blendingsimulator;
+
+TEST(DepositLog, test_round_trip)
+{
+	const std::string filename = ::testing::TempDir() + "DepositLog-test_round_trip.bsdl";
+
+	// Span several blocks with negative deltas and a reset in between
+	const size_t count = 3 * bs::DepositLogWriter::blockSize + 17;
+	std::vector<bs::DepositRecord> records(count);
+	for (size_t i = 0; i < count; i++) {
+		records[i].x = int32_t(i % 100) - 50;
+		records[i].y = int32_t(i / 100);
+		records[i].z = -int32_t(i % 7);
+		records[i].parameterId = uint32_t(i / 1000);
+	}
+
+	{
+		bs::DepositLogWriter writer(filename, 0.5);
+		for (size_t i = 0; i < count; i++) {
+			if (i % 1000 == 0) {
+				bs::DepositParameters parameters;
+				parameters.volume = 1.0;
+				parameters.values = {double(i), 2.0};
+				writer.defineParameters(uint32_t(i / 1000), parameters);
+			}
+			if (i == 5000) {
+				writer.reset();
+			}
+			writer.write(records[i]);
+		}
+		writer.flush();
+	}
+
+	bs::DepositLogReader reader(filename);
+	EXPECT_EQ(reader.getPositionScale(), 0.5);
+
+	bs::DepositRecord record;
+	for (size_t i = 0; i < count; i++) {
+		ASSERT_TRUE(reader.next(record));
+		EXPECT_EQ(record.x, records[i].x);
+		EXPECT_EQ(record.y, records[i].y);
+		EXPECT_EQ(record.z, records[i].z);
+		EXPECT_EQ(record.parameterId, records[i].parameterId);
+		EXPECT_EQ(reader.getRun(), i < 5000 ? 0u : 1u);
+	}
+	EXPECT_FALSE(reader.next(record));
+
+	EXPECT_EQ(reader.getParameters(3).values, std::vector<double>({3000.0, 2.0}));
+	EXPECT_THROW(reader.getParameters(100), std::out_of_range);
+
+	std::remove(filename.c_str());
+}
+
+TEST(DepositLog, test_invalid_file)
+{
+	const std::string filename = ::testing::TempDir() + "DepositLog-test_invalid_file.bsdl";
+	{
+		std::ofstream out(filename);
+		out << "not a deposit log";
+	}
+
+	EXPECT_THROW(bs::DepositLogReader reader(filename), std::runtime_error);
+	std::remove(filename.c_str());
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include "BlendingSimulator/RandomStream.h"
+
+namespace bs = blendingsimulator;
+
+TEST(RandomStream, test_reproducible)
+{
+	bs::RandomStream a(42, 3);
+	bs::RandomStream b(42, 3);
+	for (int i = 0; i < 100; i++) {
+		EXPECT_EQ(a.next(), b.next());
+	}
+
+	// Counter addresses draws directly
+	bs::RandomStream c(42, 3);
+	c.setCounter(50);
+	bs::RandomStream d(42, 3);
+	for (int i = 0; i < 50; i++) {
+		d.next();
+	}
+	EXPECT_EQ(c.next(), d.next());
+}
+
+TEST(RandomStream, test_independent)
+{
+	bs::RandomStream a(42, 0);
+	bs::RandomStream b(42, 1);
+	bs::RandomStream c(43, 0);
+	EXPECT_NE(a.next(), b.next());
+	EXPECT_NE(a.next(), c.next());
+
+	// Split streams do not depend on draws from their parent
+	bs::RandomStream parent(42);
+	const uint64_t first = parent.split(7).next();
+	parent.next();
+	EXPECT_EQ(parent.split(7).next(), first);
+	EXPECT_NE(parent.split(8).next(), first);
+}
+
+TEST(RandomStream, test_ranges)
+{
+	bs::RandomStream random(1);
+	int counts[8] = {};
+	double sum = 0.0;
+	const int n = 80000;
+	for (int i = 0; i < n; i++) {
+		const double u = random.uniform();
+		ASSERT_GE(u, 0.0);
+		ASSERT_LT(u, 1.0);
+		sum += u;
+
+		const float f = random.uniform(-2.0f, 2.0f);
+		ASSERT_GE(f, -2.0f);
+		ASSERT_LE(f, 2.0f);
+
+		const int k = random.uniformInt(8);
+		ASSERT_GE(k, 0);
+		ASSERT_LT(k, 8);
+		counts[k]++;
+	}
+
+	EXPECT_NEAR(sum / n, 0.5, 0.01);
+	for (int count : counts) {
+		EXPECT_NEAR(count, n / 8, n / 80);
+	}
+}
@@ -0,0 +1,107 @@
+// Scopes are tested independently of ENABLE_TRACING
+#ifndef BLENDINGSIMULATOR_TRACING
+#define BLENDINGSIMULATOR_TRACING
+#endif
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+#include "BlendingSimulator/Tracing.h"
+
+namespace bs = blendingsimulator;
+
+namespace
+{
+std::vector<bs::tracing::Event> getAllEvents()
+{
+	std::vector<bs::tracing::Event> events;
+	for (const auto& buffer : bs::tracing::Registry::get().getBuffers()) {
+		const auto bufferEvents = buffer->getEvents();
+		events.insert(events.end(), bufferEvents.begin(), bufferEvents.end());
+	}
+	return events;
+}
+}
+
+TEST(Tracing, test_nested_scopes)
+{
+	bs::tracing::clear();
+
+	{
+		BLENDINGSIMULATOR_TRACE_SCOPE("outer");
+		{
+			BLENDINGSIMULATOR_TRACE_SCOPE("inner");
+		}
+	}
+
+	const auto events = bs::tracing::getThreadBuffer().getEvents();
+	ASSERT_EQ(events.size(), 2u);
+	EXPECT_STREQ(events[0].name, "inner");
+	EXPECT_STREQ(events[1].name, "outer");
+	EXPECT_GE(events[0].start, events[1].start);
+	EXPECT_LE(events[0].start + events[0].duration, events[1].start + events[1].duration);
+}
+
+TEST(Tracing, test_threads_and_export)
+{
+	bs::tracing::clear();
+
+	std::thread worker([]() {
+		BLENDINGSIMULATOR_TRACE_SCOPE("worker");
+	});
+	worker.join();
+	{
+		BLENDINGSIMULATOR_TRACE_SCOPE("main");
+	}
+
+	// Events of finished threads remain available
+	const auto events = getAllEvents();
+	ASSERT_EQ(events.size(), 2u);
+	EXPECT_TRUE(std::any_of(events.begin(), events.end(), [](const bs::tracing::Event& e) { return std::string(e.name) == "worker"; }));
+
+	std::stringstream out;
+	bs::tracing::writeChromeTrace(out);
+	const std::string trace = out.str();
+	EXPECT_EQ(trace.rfind("{\"traceEvents\":[", 0), 0u);
+	EXPECT_NE(trace.find("\"name\":\"worker\",\"ph\":\"X\""), std::string::npos);
+	EXPECT_NE(trace.find("\"name\":\"main\",\"ph\":\"X\""), std::string::npos);
+}
+
+TEST(Tracing, test_buffers_of_finished_threads_are_reused)
+{
+	bs::tracing::clear();
+
+	std::thread([]() {
+		BLENDINGSIMULATOR_TRACE_SCOPE("first");
+	}).join();
+	const size_t bufferCount = bs::tracing::Registry::get().getBuffers().size();
+
+	for (int i = 0; i < 10; i++) {
+		std::thread([]() {
+			BLENDINGSIMULATOR_TRACE_SCOPE("worker");
+		}).join();
+	}
+	EXPECT_EQ(bs::tracing::Registry::get().getBuffers().size(), bufferCount);
+
+	// A reused buffer keeps the events of its previous thread
+	const auto events = getAllEvents();
+	EXPECT_EQ(events.size(), 11u);
+	EXPECT_TRUE(std::any_of(events.begin(), events.end(), [](const bs::tracing::Event& e) { return std::string(e.name) == "first"; }));
+}
+
+TEST(Tracing, test_ring_buffer_overwrites_oldest)
+{
+	bs::tracing::ThreadBuffer buffer(1);
+	const size_t count = bs::tracing::ThreadBuffer::capacity + 10;
+	for (size_t i = 0; i < count; i++) {
+		buffer.push({"event", int64_t(i), 0});
+	}
+
+	const auto events = buffer.getEvents();
+	ASSERT_EQ(events.size(), bs::tracing::ThreadBuffer::capacity);
+	EXPECT_EQ(events.front().start, 10);
+	EXPECT_EQ(events.back().start, int64_t(count - 1));
+}
@@ -0,0 +1,112 @@
+#ifndef BLENDINGSIMULATOR_C_H
+#define BLENDINGSIMULATOR_C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(BLENDINGSIMULATOR_C_BUILD)
+#define BS_API __declspec(dllexport)
+#else
+#define BS_API __declspec(dllimport)
+#endif
+#else
+#define BS_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Incremented on every incompatible change of the functions or structures below */
+#define BS_API_VERSION 1
+
+/* Return codes, details of the last error on the calling thread are available from bs_last_error() */
+#define BS_OK 0
+#define BS_ERROR (-1)
+
+#define BS_SIMULATOR_FAST 0
+#define BS_SIMULATOR_DETAILED 1
+
+#define BS_SHAPE_BOX 0
+#define BS_SHAPE_SPHERE 1
+#define BS_SHAPE_ROLLING_SPHERE 2
+
+typedef struct bs_simulator bs_simulator;
+
+/* Mirrors blendingsimulator::SimulationParameters, always initialize with bs_parameters_init() */
+typedef struct bs_parameters
+{
+	/* Size of this structure as known to the caller for forward compatibility */
+	size_t struct_size;
+
+	int simulator_type;
+
+	/* Generic */
+	float heap_world_size_x;
+	float heap_world_size_z;
+	float reclaim_angle;
+	float particles_per_cubic_meter;
+	int circular;
+	uint64_t seed;
+	uint64_t random_stream;
+
+	/* Fast simulation */
+	float eight_likelihood;
+	int accelerated_descent;
+
+	/* Detailed simulation */
+	float bulk_density_factor;
+	int particle_shape;
+	float drop_height;
+	unsigned int physics_partitions;
+} bs_parameters;
+
+BS_API int bs_api_version(void);
+
+/* Message of the last failed call on the calling thread, empty if none failed */
+BS_API const char* bs_last_error(void);
+
+BS_API void bs_parameters_init(bs_parameters* parameters);
+
+/* Returns NULL on error */
+BS_API bs_simulator* bs_create(const bs_parameters* parameters);
+BS_API void bs_destroy(bs_simulator* simulator);
+
+BS_API int bs_clear(bs_simulator* simulator);
+
+/* Stacks count records, values holds value_count values per record row by row */
+BS_API int bs_stack(
+	bs_simulator* simulator,
+	size_t count,
+	const float* x,
+	const float* z,
+	const double* volume,
+	const double* values,
+	unsigned int value_count
+);
+
+/* Completes all stacking, required before reclaiming with the detailed simulator */
+BS_API int bs_finish_stacking(bs_simulator* simulator);
+
+/* Reclaims up to each of count increasing positions, volume receives count and values count * value_count entries */
+BS_API int bs_reclaim(
+	bs_simulator* simulator,
+	size_t count,
+	const float* positions,
+	double* volume,
+	double* values,
+	unsigned int value_count
+);
+
+/* Returns 1 when all material is reclaimed, 0 otherwise and BS_ERROR on error */
+BS_API int bs_reclaiming_finished(bs_simulator* simulator);
+
+/* Points heights to the simulator owned height map of size_x * size_z floats (z major), valid until the next call on simulator */
+BS_API int bs_get_heap_map(bs_simulator* simulator, const float** heights, unsigned int* size_x, unsigned int* size_z);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,265 @@
+#include "BlendingSimulator/BlendingSimulatorC.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "BlendingSimulator/BlendingSimulator.h"
+
+#ifdef FAST_SIMULATOR_AVAILABLE
+
+#include "BlendingSimulator/BlendingSimulatorFast.h"
+
+#endif
+
+#ifdef DETAILED_SIMULATOR_AVAILABLE
+
+#include "BlendingSimulator/BlendingSimulatorDetailed.h"
+
+#endif
+
+#include "BlendingSimulator/ParticleParameters.h"
+
+namespace bs = blendingsimulator;
+
+struct bs_simulator
+{
+	std::unique_ptr<bs::BlendingSimulator<bs::AveragedParameters>> simulator;
+
+	// Buffers reused between calls
+	std::vector<double> values;
+	bs::AveragedParameters record;
+	bs::AveragedParameters reclaimed;
+};
+
+namespace
+{
+thread_local std::string lastError;
+
+template<typename Function>
+int guarded(Function function)
+{
+	try {
+		lastError.clear();
+		function();
+		return BS_OK;
+	} catch (std::exception& e) {
+		lastError = e.what();
+	} catch (...) {
+		lastError = "unknown error";
+	}
+	return BS_ERROR;
+}
+
+void checkSimulator(const bs_simulator* simulator)
+{
+	if (!simulator || !simulator->simulator) {
+		throw std::invalid_argument("simulator must not be null");
+	}
+}
+
+bs::SimulationParameters toSimulationParameters(const bs_parameters& parameters)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = parameters.heap_world_size_x;
+	simulationParameters.heapWorldSizeZ = parameters.heap_world_size_z;
+	simulationParameters.reclaimAngle = parameters.reclaim_angle;
+	simulationParameters.particlesPerCubicMeter = parameters.particles_per_cubic_meter;
+	simulationParameters.circular = parameters.circular != 0;
+	simulationParameters.seed = parameters.seed;
+	simulationParameters.randomStream = parameters.random_stream;
+	simulationParameters.eightLikelihood = parameters.eight_likelihood;
+	simulationParameters.acceleratedDescent = parameters.accelerated_descent != 0;
+	simulationParameters.bulkDensityFactor = parameters.bulk_density_factor;
+	simulationParameters.dropHeight = parameters.drop_height;
+	simulationParameters.physicsPartitions = parameters.physics_partitions;
+
+	switch (parameters.particle_shape) {
+		case BS_SHAPE_BOX:
+			simulationParameters.particleShape = bs::ParticleShape::Box;
+			break;
+		case BS_SHAPE_SPHERE:
+			simulationParameters.particleShape = bs::ParticleShape::Sphere;
+			break;
+		case BS_SHAPE_ROLLING_SPHERE:
+			simulationParameters.particleShape = bs::ParticleShape::RollingSphere;
+			break;
+		default:
+			throw std::invalid_argument("invalid particle shape " + std::to_string(parameters.particle_shape));
+	}
+
+	return simulationParameters;
+}
+}
+
+int bs_api_version(void)
+{
+	return BS_API_VERSION;
+}
+
+const char* bs_last_error(void)
+{
+	return lastError.c_str();
+}
+
+void bs_parameters_init(bs_parameters* parameters)
+{
+	if (!parameters) {
+		return;
+	}
+
+	const bs::SimulationParameters defaults;
+	parameters->struct_size = sizeof(bs_parameters);
+	parameters->simulator_type = BS_SIMULATOR_FAST;
+	parameters->heap_world_size_x = defaults.heapWorldSizeX;
+	parameters->heap_world_size_z = defaults.heapWorldSizeZ;
+	parameters->reclaim_angle = defaults.reclaimAngle;
+	parameters->particles_per_cubic_meter = defaults.particlesPerCubicMeter;
+	parameters->circular = defaults.circular ? 1 : 0;
+	parameters->seed = defaults.seed;
+	parameters->random_stream = defaults.randomStream;
+	parameters->eight_likelihood = defaults.eightLikelihood;
+	parameters->accelerated_descent = defaults.acceleratedDescent ? 1 : 0;
+	parameters->bulk_density_factor = defaults.bulkDensityFactor;
+	parameters->particle_shape = BS_SHAPE_BOX;
+	parameters->drop_height = defaults.dropHeight;
+	parameters->physics_partitions = defaults.physicsPartitions;
+}
+
+bs_simulator* bs_create(const bs_parameters* parameters)
+{
+	std::unique_ptr<bs_simulator> simulator;
+
+	const int result = guarded([&]() {
+		if (!parameters) {
+			throw std::invalid_argument("parameters must not be null");
+		}
+
+		// Fields unknown to older callers keep their defaults
+		bs_parameters p;
+		bs_parameters_init(&p);
+		std::memcpy(&p, parameters, std::min(parameters->struct_size, sizeof(bs_parameters)));
+
+		const bs::SimulationParameters simulationParameters = toSimulationParameters(p);
+		simulator.reset(new bs_simulator());
+
+		if (p.simulator_type == BS_SIMULATOR_DETAILED) {
+#ifdef DETAILED_SIMULATOR_AVAILABLE
+			simulator->simulator.reset(new bs::BlendingSimulatorDetailed<bs::AveragedParameters>(simulationParameters));
+#else
+			throw std::runtime_error("Detailed simulation not available");
+#endif
+		} else if (p.simulator_type == BS_SIMULATOR_FAST) {
+#ifdef FAST_SIMULATOR_AVAILABLE
+			simulator->simulator.reset(new bs::BlendingSimulatorFast<bs::AveragedParameters>(simulationParameters));
+#else
+			throw std::runtime_error("Fast simulation not available");
+#endif
+		} else {
+			throw std::invalid_argument("invalid simulator type " + std::to_string(p.simulator_type));
+		}
+	});
+
+	return result == BS_OK ? simulator.release() : nullptr;
+}
+
+void bs_destroy(bs_simulator* simulator)
+{
+	delete simulator;
+}
+
+int bs_clear(bs_simulator* simulator)
+{
+	return guarded([&]() {
+		checkSimulator(simulator);
+		simulator->simulator->clear();
+	});
+}
+
+int bs_stack(
+	bs_simulator* simulator,
+	size_t count,
+	const float* x,
+	const float* z,
+	const double* volume,
+	const double* values,
+	unsigned int value_count
+)
+{
+	return guarded([&]() {
+		checkSimulator(simulator);
+		if (count > 0 && (!x || !z || !volume || (value_count > 0 && !values))) {
+			throw std::invalid_argument("input arrays must not be null");
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			simulator->values.assign(values + i * value_count, values + (i + 1) * value_count);
+			simulator->record.clear();
+			simulator->record.push(volume[i], simulator->values);
+			simulator->simulator->stack(x[i], z[i], simulator->record);
+		}
+	});
+}
+
+int bs_finish_stacking(bs_simulator* simulator)
+{
+	return guarded([&]() {
+		checkSimulator(simulator);
+		simulator->simulator->finishStacking();
+	});
+}
+
+int bs_reclaim(
+	bs_simulator* simulator,
+	size_t count,
+	const float* positions,
+	double* volume,
+	double* values,
+	unsigned int value_count
+)
+{
+	return guarded([&]() {
+		checkSimulator(simulator);
+		if (count > 0 && (!positions || !volume || (value_count > 0 && !values))) {
+			throw std::invalid_argument("reclaim arrays must not be null");
+		}
+
+		bs::AveragedParameters& reclaimed = simulator->reclaimed;
+		for (size_t i = 0; i < count; i++) {
+			simulator->simulator->reclaimInto(positions[i], reclaimed);
+
+			volume[i] = reclaimed.getVolume();
+			for (unsigned int j = 0; j < value_count; j++) {
+				values[i * value_count + j] = reclaimed.getValue(j);
+			}
+		}
+	});
+}
+
+int bs_reclaiming_finished(bs_simulator* simulator)
+{
+	bool finished = false;
+	const int result = guarded([&]() {
+		checkSimulator(simulator);
+		finished = simulator->simulator->reclaimingFinished();
+	});
+	return result == BS_OK ? (finished ? 1 : 0) : result;
+}
+
+int bs_get_heap_map(bs_simulator* simulator, const float** heights, unsigned int* size_x, unsigned int* size_z)
+{
+	return guarded([&]() {
+		checkSimulator(simulator);
+		if (!heights || !size_x || !size_z) {
+			throw std::invalid_argument("output pointers must not be null");
+		}
+
+		const std::pair<unsigned int, unsigned int> heapMapSize = simulator->simulator->getHeapMapSize();
+		*heights = simulator->simulator->getHeapMap();
+		*size_x = heapMapSize.first;
+		*size_z = heapMapSize.second;
+	});
+}
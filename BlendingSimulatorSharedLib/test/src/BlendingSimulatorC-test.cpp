@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "BlendingSimulator/BlendingSimulatorC.h"
+
+TEST(BlendingSimulatorC, test_create_destroy)
+{
+	EXPECT_EQ(bs_api_version(), BS_API_VERSION);
+
+	bs_parameters parameters;
+	bs_parameters_init(&parameters);
+	bs_simulator* simulator = bs_create(&parameters);
+	ASSERT_NE(simulator, nullptr);
+	EXPECT_STREQ(bs_last_error(), "");
+	bs_destroy(simulator);
+}
+
+TEST(BlendingSimulatorC, test_errors)
+{
+	EXPECT_EQ(bs_create(nullptr), nullptr);
+	EXPECT_STRNE(bs_last_error(), "");
+
+	bs_parameters parameters;
+	bs_parameters_init(&parameters);
+	parameters.simulator_type = 42;
+	EXPECT_EQ(bs_create(&parameters), nullptr);
+	EXPECT_NE(std::string(bs_last_error()).find("simulator type"), std::string::npos);
+
+	EXPECT_EQ(bs_clear(nullptr), BS_ERROR);
+}
+
+TEST(BlendingSimulatorC, test_stack_reclaim)
+{
+	bs_parameters parameters;
+	bs_parameters_init(&parameters);
+	parameters.heap_world_size_x = 3.0f;
+	parameters.heap_world_size_z = 1.0f;
+	parameters.reclaim_angle = 90.0f;
+	parameters.eight_likelihood = 0.0f;
+	parameters.particles_per_cubic_meter = 1.0f;
+	parameters.seed = 1;
+
+	bs_simulator* simulator = bs_create(&parameters);
+	ASSERT_NE(simulator, nullptr);
+
+	const std::vector<float> x = {0.0f, 1.0f, 2.0f};
+	const std::vector<float> z = {0.0f, 0.0f, 0.0f};
+	const std::vector<double> volume = {1.0, 1.0, 1.0};
+	const std::vector<double> values = {1.0, 10.0, 2.0, 20.0, 3.0, 30.0};
+	ASSERT_EQ(bs_stack(simulator, x.size(), x.data(), z.data(), volume.data(), values.data(), 2), BS_OK);
+	ASSERT_EQ(bs_finish_stacking(simulator), BS_OK);
+
+	const float* heights = nullptr;
+	unsigned int sizeX = 0;
+	unsigned int sizeZ = 0;
+	ASSERT_EQ(bs_get_heap_map(simulator, &heights, &sizeX, &sizeZ), BS_OK);
+	ASSERT_EQ(sizeX, 3);
+	ASSERT_EQ(sizeZ, 1);
+	for (unsigned int i = 0; i < sizeX * sizeZ; i++) {
+		EXPECT_NEAR(heights[i], 1.0, 1e-6);
+	}
+
+	EXPECT_EQ(bs_reclaiming_finished(simulator), 0);
+	const std::vector<float> positions = {1.0f, 2.0f, 3.0f};
+	std::vector<double> reclaimedVolume(3);
+	std::vector<double> reclaimedValues(6);
+	ASSERT_EQ(bs_reclaim(simulator, positions.size(), positions.data(), reclaimedVolume.data(), reclaimedValues.data(), 2), BS_OK);
+	for (unsigned int i = 0; i < 3; i++) {
+		EXPECT_NEAR(reclaimedVolume[i], 1.0, 1e-10);
+		EXPECT_NEAR(reclaimedValues[2 * i], values[2 * i], 1e-10);
+		EXPECT_NEAR(reclaimedValues[2 * i + 1], values[2 * i + 1], 1e-10);
+	}
+	EXPECT_EQ(bs_reclaiming_finished(simulator), 1);
+
+	// Exceptions are reported instead of crossing the C boundary
+	EXPECT_EQ(bs_stack(simulator, 1, nullptr, z.data(), volume.data(), values.data(), 2), BS_ERROR);
+	EXPECT_STRNE(bs_last_error(), "");
+
+	bs_destroy(simulator);
+}
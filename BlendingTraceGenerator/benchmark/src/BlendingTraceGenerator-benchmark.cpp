@@ -0,0 +1,250 @@
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __unix__
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "BlendingSimulator/AllocationAccounting.h"
+#include "BlendingSimulator/BlendingSimulator.h"
+#include "BlendingSimulator/ParticleParameters.h"
+
+#ifdef FAST_SIMULATOR_AVAILABLE
+
+#include "BlendingSimulator/BlendingSimulatorFast.h"
+
+#endif
+
+#ifdef DETAILED_SIMULATOR_AVAILABLE
+
+#include "BlendingSimulator/BlendingSimulatorDetailed.h"
+
+#endif
+
+#include "TraceGenerator.h"
+
+#ifdef BLENDINGSIMULATOR_ALLOCATION_ACCOUNTING
+
+#include "BlendingSimulator/AllocationInterposer.h"
+
+#endif
+
+namespace bs = blendingsimulator;
+
+struct Scenario
+{
+	std::string name;
+	bool circular;
+	float bedLength;
+	float bedDepth;
+	std::function<std::string()> loadTrace; // Called in the process running the scenario only
+};
+
+struct PhaseTimes
+{
+	double read = 0.0;
+	double stack = 0.0;
+	double reclaim = 0.0;
+};
+
+// High water mark of the whole process, each scenario runs in its own process for isolated numbers
+long getPeakRss()
+{
+#ifdef __unix__
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+#else
+	return 0;
+#endif
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::unique_ptr<bs::BlendingSimulator<bs::AveragedParameters>> createSimulator(bool detailed, const bs::SimulationParameters& simulationParameters)
+{
+	if (detailed) {
+#ifdef DETAILED_SIMULATOR_AVAILABLE
+		return std::unique_ptr<bs::BlendingSimulator<bs::AveragedParameters>>(new bs::BlendingSimulatorDetailed<bs::AveragedParameters>(simulationParameters));
+#endif
+	} else {
+#ifdef FAST_SIMULATOR_AVAILABLE
+		return std::unique_ptr<bs::BlendingSimulator<bs::AveragedParameters>>(new bs::BlendingSimulatorFast<bs::AveragedParameters>(simulationParameters));
+#endif
+	}
+	return nullptr;
+}
+
+// Same stages as BlendingSimulatorCli: parse the text trace, stack asynchronously, reclaim in steps of 1 m
+PhaseTimes runPipeline(bs::BlendingSimulator<bs::AveragedParameters>& simulator, const std::string& trace, double& volume)
+{
+	PhaseTimes times;
+
+	auto start = std::chrono::steady_clock::now();
+	std::istringstream in(trace);
+	TraceReader reader(in);
+	std::vector<TraceRecord> records;
+	TraceRecord record;
+	while (reader.next(record)) {
+		records.push_back(record);
+	}
+	times.read = secondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	volume = 0.0;
+	for (const TraceRecord& r : records) {
+		simulator.stackAsync(r.x, r.z, bs::AveragedParameters(r.volume, r.values));
+		volume += r.volume;
+	}
+	simulator.finishStackingAsync().get();
+	times.stack = secondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	bs::AveragedParameters p;
+	for (float position = 0.0f; !simulator.reclaimingFinished(); position += 1.0f) {
+		simulator.reclaimInto(position, p);
+	}
+	times.reclaim = secondsSince(start);
+
+	return times;
+}
+
+std::string generateTrace(TraceType type, double hours)
+{
+	TraceParameters parameters;
+	parameters.type = type;
+	parameters.duration = hours * 3600.0;
+	parameters.componentCount = 3;
+
+	std::ostringstream out;
+	TraceGenerator generator(parameters);
+	TraceWriter writer(out, TraceFormat::Text, parameters.componentCount);
+	TraceRecord record;
+	while (generator.next(record)) {
+		writer.write(record);
+	}
+	return out.str();
+}
+
+// Prints one result row, returns false if the simulator is not available
+bool runScenario(const Scenario& scenario, bool detailed, float particlesPerCubicMeter)
+{
+	bs::SimulationParameters simulationParameters;
+	simulationParameters.heapWorldSizeX = scenario.bedLength;
+	simulationParameters.heapWorldSizeZ = scenario.bedDepth;
+	simulationParameters.circular = scenario.circular;
+	simulationParameters.particlesPerCubicMeter = particlesPerCubicMeter;
+	simulationParameters.seed = 1;
+
+	const std::string trace = scenario.loadTrace();
+
+	bs::allocation::reset();
+	const auto start = std::chrono::steady_clock::now();
+	const auto simulator = createSimulator(detailed, simulationParameters);
+	if (!simulator) {
+		std::cerr << (detailed ? "Detailed" : "Fast") << " simulation not available" << std::endl;
+		return false;
+	}
+
+	double volume = 0.0;
+	const PhaseTimes times = runPipeline(*simulator, trace, volume);
+	const double wall = secondsSince(start);
+	const double particles = volume * particlesPerCubicMeter;
+
+	std::cout << scenario.name << "\t" << (detailed ? "detailed" : "fast") << "\t" << particles << "\t" << times.read << "\t" << times.stack
+		<< "\t" << times.reclaim << "\t" << wall << "\t" << particles / times.stack << "\t" << getPeakRss();
+	if (bs::allocation::enabled) {
+		for (size_t i = 0; i < bs::allocation::phaseCount; i++) {
+			std::cout << "\t" << double(bs::allocation::getCounters(static_cast<bs::allocation::Phase>(i)).count) / particles;
+		}
+	}
+	std::cout << std::endl;
+	return true;
+}
+
+// Forks a child per scenario so that neither traces nor the peak RSS of other scenarios are included
+bool runScenarioIsolated(const Scenario& scenario, bool detailed, float particlesPerCubicMeter)
+{
+#ifdef __unix__
+	std::cout.flush();
+	const pid_t pid = fork();
+	if (pid < 0) {
+		std::cerr << "Could not fork for scenario " << scenario.name << std::endl;
+		return false;
+	} else if (pid == 0) {
+		const bool success = runScenario(scenario, detailed, particlesPerCubicMeter);
+		std::cout.flush();
+		_exit(success ? 0 : 1);
+	}
+
+	int status = 0;
+	if (waitpid(pid, &status, 0) != pid) {
+		return false;
+	}
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#else
+	return runScenario(scenario, detailed, particlesPerCubicMeter);
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+	// Usage: [fast|detailed] [hours of generated traces] [particles per m³] [trace files...]
+	const bool detailed = argc > 1 && std::string(argv[1]) == "detailed";
+	const double hours = argc > 2 ? std::stod(argv[2]) : (detailed ? 0.5 : 24.0);
+	const float particlesPerCubicMeter = argc > 3 ? std::stof(argv[3]) : 1.0f;
+
+	std::vector<Scenario> scenarios;
+	if (argc > 4) {
+		// Files are expected to fit the default linear bed of the generator
+		for (int i = 4; i < argc; i++) {
+			const std::string filename = argv[i];
+			const auto loadTrace = [filename]() {
+				std::ifstream in(filename, std::ios::binary);
+				std::ostringstream text;
+				TraceReader reader(in);
+				TraceRecord record;
+				while (reader.next(record)) {
+					TraceWriter(text, TraceFormat::Text, static_cast<unsigned int>(record.values.size())).write(record);
+				}
+				return text.str();
+			};
+			TraceParameters defaults;
+			scenarios.push_back({filename, false, defaults.bedLength, defaults.bedDepth, loadTrace});
+		}
+	} else {
+		TraceParameters defaults;
+		for (TraceType type : {TraceType::Chevron, TraceType::Windrow, TraceType::Chevcon, TraceType::Circular}) {
+			const auto loadTrace = [type, hours]() {
+				return generateTrace(type, hours);
+			};
+			scenarios.push_back({getTraceTypeName(type), type == TraceType::Circular, defaults.bedLength, defaults.bedDepth, loadTrace});
+		}
+	}
+
+	std::cout << "scenario\tsimulator\tparticles\tread_seconds\tstack_seconds\treclaim_seconds\twall_seconds\tparticles_per_second\tpeak_rss_kb";
+	if (bs::allocation::enabled) {
+		for (size_t i = 0; i < bs::allocation::phaseCount; i++) {
+			std::cout << "\t" << bs::allocation::getPhaseName(static_cast<bs::allocation::Phase>(i)) << "_allocations_per_particle";
+		}
+	}
+	std::cout << std::endl;
+	for (const Scenario& scenario : scenarios) {
+		if (!runScenarioIsolated(scenario, detailed, particlesPerCubicMeter)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
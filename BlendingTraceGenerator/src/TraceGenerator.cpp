@@ -0,0 +1,225 @@
+#include "TraceGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+const char traceMagic[4] = {'B', 'S', 'T', 'R'};
+const uint32_t traceVersion = 1;
+
+// Quality parameters fluctuate around 1 as first order autoregressive processes
+const double qualityMean = 1.0;
+const double qualityCorrelation = 0.98;
+const double qualityDeviation = 0.1;
+
+template<typename T>
+void writeRaw(std::ostream& out, T value)
+{
+	char bytes[sizeof(T)];
+	std::memcpy(bytes, &value, sizeof(T));
+	out.write(bytes, sizeof(T));
+}
+
+template<typename T>
+bool readRaw(std::istream& in, T& value)
+{
+	char bytes[sizeof(T)];
+	if (!in.read(bytes, sizeof(T))) {
+		return false;
+	}
+	std::memcpy(&value, bytes, sizeof(T));
+	return true;
+}
+}
+
+TraceType parseTraceType(const std::string& name)
+{
+	if (name == "chevron") {
+		return TraceType::Chevron;
+	} else if (name == "windrow") {
+		return TraceType::Windrow;
+	} else if (name == "chevcon") {
+		return TraceType::Chevcon;
+	} else if (name == "circular") {
+		return TraceType::Circular;
+	}
+	throw std::runtime_error("invalid trace type '" + name + "'");
+}
+
+const char* getTraceTypeName(TraceType type)
+{
+	switch (type) {
+		case TraceType::Chevron:
+			return "chevron";
+		case TraceType::Windrow:
+			return "windrow";
+		case TraceType::Chevcon:
+			return "chevcon";
+		case TraceType::Circular:
+			return "circular";
+	}
+	return "unknown";
+}
+
+TraceGenerator::TraceGenerator(const TraceParameters& parameters)
+	: parameters(parameters)
+	, random(parameters.seed)
+	, step(0)
+	, quality(parameters.componentCount, qualityMean)
+{
+	if (parameters.bedLength <= 0.0f || parameters.bedDepth <= 0.0f || parameters.timeStep <= 0.0) {
+		throw std::runtime_error("trace geometry and time step must be positive");
+	}
+}
+
+bool TraceGenerator::next(TraceRecord& record)
+{
+	const double time = double(step) * parameters.timeStep;
+	if (time >= parameters.duration) {
+		return false;
+	}
+
+	record.time = time;
+	record.volume = parameters.volumeRate * parameters.timeStep;
+	getStackerPosition(double(parameters.stackerSpeed) * time, record.x, record.z);
+
+	// Uniform noise scaled to unit variance
+	const double noiseScale = qualityDeviation * std::sqrt(1.0 - qualityCorrelation * qualityCorrelation) * std::sqrt(3.0);
+	record.values.resize(quality.size());
+	for (size_t i = 0; i < quality.size(); i++) {
+		quality[i] = qualityMean + qualityCorrelation * (quality[i] - qualityMean) + noiseScale * (2.0 * random.uniform() - 1.0);
+		record.values[i] = quality[i];
+	}
+
+	step++;
+	return true;
+}
+
+void TraceGenerator::getStackerPosition(double distance, float& x, float& z) const
+{
+	const double length = parameters.bedLength;
+	const double depth = parameters.bedDepth;
+
+	switch (parameters.type) {
+		case TraceType::Chevron: {
+			const double p = std::fmod(distance, 2.0 * length);
+			x = float(p < length ? p : 2.0 * length - p);
+			z = float(0.5 * depth);
+			break;
+		}
+		case TraceType::Windrow: {
+			const auto pass = uint64_t(distance / length);
+			const double offset = distance - double(pass) * length;
+			const unsigned int lanes = std::max(1u, parameters.windrows);
+			x = float(pass % 2 == 0 ? offset : length - offset);
+			z = float(depth * (double(pass % lanes) + 0.5) / double(lanes));
+			break;
+		}
+		case TraceType::Chevcon: {
+			const double section = std::min(double(parameters.chevconSection), length);
+			const auto pass = uint64_t(distance / section);
+			const double offset = distance - double(pass) * section;
+			const double start = std::min(double(pass) * parameters.chevconAdvance, length - section);
+			x = float(start + (pass % 2 == 0 ? offset : section - offset));
+			z = float(0.5 * depth);
+			break;
+		}
+		case TraceType::Circular: {
+			const double radius = 0.25 * std::min(length, depth);
+			const double angle = distance / radius;
+			x = float(0.5 * length + radius * std::cos(angle));
+			z = float(0.5 * depth + radius * std::sin(angle));
+			break;
+		}
+	}
+}
+
+TraceWriter::TraceWriter(std::ostream& out, TraceFormat format, unsigned int componentCount)
+	: out(out)
+	, format(format)
+	, componentCount(componentCount)
+{
+	if (format == TraceFormat::Binary) {
+		out.write(traceMagic, 4);
+		writeRaw(out, traceVersion);
+		writeRaw(out, uint32_t(componentCount));
+	}
+}
+
+void TraceWriter::write(const TraceRecord& record)
+{
+	if (record.values.size() != componentCount) {
+		throw std::runtime_error("invalid parameter count");
+	}
+
+	if (format == TraceFormat::Binary) {
+		writeRaw(out, record.time);
+		writeRaw(out, record.x);
+		writeRaw(out, record.z);
+		writeRaw(out, record.volume);
+		for (double value : record.values) {
+			writeRaw(out, value);
+		}
+	} else {
+		out << record.time << "\t" << record.x << "\t" << record.z << "\t" << record.volume;
+		for (double value : record.values) {
+			out << "\t" << value;
+		}
+		out << "\n";
+	}
+}
+
+TraceReader::TraceReader(std::istream& in)
+	: in(in)
+	, format(TraceFormat::Text)
+	, componentCount(0)
+{
+	// Text traces start with a number so the first byte suffices to tell the formats apart
+	if (in.peek() == traceMagic[0]) {
+		char magic[4];
+		uint32_t version = 0;
+		uint32_t count = 0;
+		if (!in.read(magic, 4) || std::memcmp(magic, traceMagic, 4) != 0 || !readRaw(in, version) || version != traceVersion
+			|| !readRaw(in, count)) {
+			throw std::runtime_error("unsupported binary trace");
+		}
+		format = TraceFormat::Binary;
+		componentCount = count;
+	}
+}
+
+bool TraceReader::next(TraceRecord& record)
+{
+	if (format == TraceFormat::Binary) {
+		if (!readRaw(in, record.time)) {
+			return false;
+		}
+		record.values.resize(componentCount);
+		bool complete = readRaw(in, record.x) && readRaw(in, record.z) && readRaw(in, record.volume);
+		for (double& value : record.values) {
+			complete = complete && readRaw(in, value);
+		}
+		if (!complete) {
+			throw std::runtime_error("truncated binary trace");
+		}
+		return true;
+	}
+
+	while (std::getline(in, line)) {
+		std::istringstream lineStream(line);
+		if (!(lineStream >> record.time >> record.x >> record.z >> record.volume)) {
+			continue;
+		}
+		record.values.clear();
+		double value;
+		while (lineStream >> value) {
+			record.values.push_back(value);
+		}
+		return true;
+	}
+	return false;
+}
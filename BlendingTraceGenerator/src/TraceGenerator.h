@@ -0,0 +1,122 @@
+#ifndef BLENDINGSIMULATOR_TRACEGENERATOR_H
+#define BLENDINGSIMULATOR_TRACEGENERATOR_H
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "BlendingSimulator/RandomStream.h"
+
+enum class TraceType
+{
+	Chevron, // Stacker moves back and forth along the whole bed
+	Windrow, // Passes along the bed in lanes side by side across its depth
+	Chevcon, // Chevron over a short section which advances along the bed continuously
+	Circular // Stacker turns around the center of a circular bed
+};
+
+enum class TraceFormat
+{
+	Text,
+	Binary
+};
+
+struct TraceParameters
+{
+	TraceType type = TraceType::Chevron;
+
+	// Geometry of the bed in m, circular beds use a ring of a quarter of the smaller size as radius like the simulators
+	float bedLength = 300.0f;
+	float bedDepth = 50.0f;
+
+	// Duration and resolution of the trace in s
+	double duration = 24.0 * 3600.0;
+	double timeStep = 10.0;
+
+	// Stacker speed along the bed or the ring in m/s
+	float stackerSpeed = 0.2f;
+
+	// Material flow in m³/s
+	double volumeRate = 0.5;
+
+	// Amount of quality parameters per record, each following an independent fluctuating process
+	unsigned int componentCount = 1;
+
+	// Amount of lanes in windrow traces
+	unsigned int windrows = 5;
+
+	// Length of the stacked section in m and its advance per pass in chevcon traces
+	float chevconSection = 30.0f;
+	float chevconAdvance = 1.0f;
+
+	uint64_t seed = 1;
+};
+
+// Same columns as the input of BlendingSimulatorCli: time x z volume parameters...
+struct TraceRecord
+{
+	double time = 0.0;
+	float x = 0.0f;
+	float z = 0.0f;
+	double volume = 0.0;
+	std::vector<double> values;
+};
+
+TraceType parseTraceType(const std::string& name);
+const char* getTraceTypeName(TraceType type);
+
+// Produces the records of a trace one at a time so that traces of any length can be streamed
+class TraceGenerator
+{
+	public:
+		explicit TraceGenerator(const TraceParameters& parameters);
+
+		bool next(TraceRecord& record);
+
+	private:
+		TraceParameters parameters;
+		blendingsimulator::RandomStream random;
+		uint64_t step;
+		std::vector<double> quality;
+
+		void getStackerPosition(double distance, float& x, float& z) const;
+};
+
+// Binary traces start with "BSTR", uint32 version and uint32 component count followed by records of
+// float64 time, float32 x, float32 z, float64 volume and float64 values, all little endian
+class TraceWriter
+{
+	public:
+		TraceWriter(std::ostream& out, TraceFormat format, unsigned int componentCount);
+
+		void write(const TraceRecord& record);
+
+	private:
+		std::ostream& out;
+		TraceFormat format;
+		unsigned int componentCount;
+};
+
+// Reads text and binary traces, the format is detected from the first bytes
+class TraceReader
+{
+	public:
+		explicit TraceReader(std::istream& in);
+
+		bool next(TraceRecord& record);
+
+		TraceFormat getFormat() const
+		{
+			return format;
+		}
+
+	private:
+		std::istream& in;
+		TraceFormat format;
+		unsigned int componentCount;
+		std::string line;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#include <CLI/CLI.hpp>
+
+#include "TraceGenerator.h"
+
+int main(const int argc, char* argv[]) try
+{
+	TraceParameters parameters;
+	std::string type = getTraceTypeName(parameters.type);
+	TraceFormat format = TraceFormat::Text;
+	std::string outputFile = "stdout";
+
+	CLI::App app{"Blending Trace Generator"};
+	app.set_version_flag("-V,--version", std::string(PROJECT_VERSION));
+
+	// Trace Options
+	app.add_option("--type", type, "Stacking method")
+		->default_val(type)
+		->group("Trace Options")
+		->check(CLI::IsMember({"chevron", "windrow", "chevcon", "circular"}));
+	app.add_option("--duration", parameters.duration, "Trace duration in s")
+		->default_val(parameters.duration)
+		->group("Trace Options")
+		->check(CLI::PositiveNumber);
+	app.add_option("--timestep", parameters.timeStep, "Time between records in s")
+		->default_val(parameters.timeStep)
+		->group("Trace Options")
+		->check(CLI::PositiveNumber);
+	app.add_option("--speed", parameters.stackerSpeed, "Stacker speed in m/s")
+		->default_val(parameters.stackerSpeed)
+		->group("Trace Options")
+		->check(CLI::PositiveNumber);
+	app.add_option("--rate", parameters.volumeRate, "Material flow in m³/s")
+		->default_val(parameters.volumeRate)
+		->group("Trace Options")
+		->check(CLI::PositiveNumber);
+	app.add_option("--components", parameters.componentCount, "Amount of quality parameters")
+		->default_val(parameters.componentCount)
+		->group("Trace Options")
+		->check(CLI::Range(1u, 1000u));
+	app.add_option("--windrows", parameters.windrows, "Lanes across the bed in windrow traces")
+		->default_val(parameters.windrows)
+		->group("Trace Options")
+		->check(CLI::Range(1u, 1000u));
+	app.add_option("--section", parameters.chevconSection, "Stacked section length in chevcon traces in m")
+		->default_val(parameters.chevconSection)
+		->group("Trace Options")
+		->check(CLI::PositiveNumber);
+	app.add_option("--advance", parameters.chevconAdvance, "Advance of the section per pass in chevcon traces in m")
+		->default_val(parameters.chevconAdvance)
+		->group("Trace Options")
+		->check(CLI::NonNegativeNumber);
+	app.add_option("--seed", parameters.seed, "Seed of the quality fluctuations")
+		->default_val(parameters.seed)
+		->group("Trace Options");
+
+	// Bed Options
+	app.add_option("-l,--length", parameters.bedLength, "Blending bed length")
+		->default_val(parameters.bedLength)
+		->group("Bed Options")
+		->check(CLI::Range(0.0f, 1000000.0f));
+	app.add_option("-d,--depth", parameters.bedDepth, "Blending bed depth")
+		->default_val(parameters.bedDepth)
+		->group("Bed Options")
+		->check(CLI::Range(0.0f, 1000000.0f));
+
+	// Output Options
+	const std::map<std::string, TraceFormat> formatNames{
+		{"text", TraceFormat::Text},
+		{"binary", TraceFormat::Binary}
+	};
+	app.add_option("--format", format, "Trace format")
+		->default_str("text")
+		->group("Output Options")
+		->transform(CLI::CheckedTransformer(formatNames, CLI::ignore_case));
+	app.add_option("-o,--output", outputFile, "Trace output file")
+		->default_val(outputFile)
+		->group("Output Options");
+
+	try {
+		app.parse(argc, argv);
+	} catch (const CLI::ParseError& e) {
+		return app.exit(e);
+	}
+
+	parameters.type = parseTraceType(type);
+
+	std::ofstream of;
+	std::ostream* out = &std::cout;
+	if (outputFile != "stdout") {
+		of.open(outputFile, std::ios::binary);
+		if (!of) {
+			std::cerr << "Could not open output file stream for filename '" << outputFile << "'" << std::endl;
+			return 1;
+		}
+		out = &of;
+	}
+
+	TraceGenerator generator(parameters);
+	TraceWriter writer(*out, format, parameters.componentCount);
+	TraceRecord record;
+	while (generator.next(record)) {
+		writer.write(record);
+	}
+	out->flush();
+
+	return 0;
+} catch (std::exception& e) {
+	std::cerr << e.what() << std::endl;
+	return 1;
+}
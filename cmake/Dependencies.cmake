@@ -2,11 +2,9 @@ if (CMAKE_VERSION VERSION_GREATER_EQUAL "3.24.0")
 	cmake_policy(SET CMP0135 NEW)
 endif ()
 
-if (BUILD_CLI OR BUILD_PYTHON_LIB)
-	find_package(Threads REQUIRED)
-endif ()
+find_package(Threads REQUIRED)
 
-if (BUILD_CLI)
+if (BUILD_CLI OR BUILD_TRACE_GENERATOR)
 	include(cmake/CLI11.cmake)
 endif ()
 